@@ -0,0 +1,245 @@
+#include "chess_interface.h"
+#include "mcts.h"
+#include "pgn_reader.h"
+#include "pgn_writer.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <unordered_map>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// annotates PGN games with MCTS evaluations, best moves and mistake/blunder flags:
+// annotate [--out out.pgn] [--threads N] [--playouts N] [--mistake D] [--blunder D] [--cache N] file.pgn...
+// every distinct position of a batch of games is analysed once, on the worker it is pinned to, and the
+// games are written in input order with {[%eval E]} after each move (pawns, from white's side)
+
+#define BATCH_GAMES 512 // games expanded and analysed at once
+#define JOB_POSITIONS 16 // positions per job
+
+struct Analysis {
+    float value; // expected score for the side to move, in [0,1]
+    minfo best; // castle==INV_CAST when the game is over
+};
+
+struct AnnotateOptions {
+    float mistake = 0.1; // expected score lost by the played move for "?"
+    float blunder = 0.2; // for "??"
+    size_t cache = 1<<20; // analyses kept across batches (openings repeat between games)
+};
+
+struct GamePositions {
+    ChessState start;
+    vector<uint32_t> slots; // analysis of the position before each move, and after the last one
+    bool error = false; // the moves after slots.size()-1 could not be replayed
+};
+
+static string eval_text(const ChessState& pos, const Analysis& an) {
+    char buf[32];
+    if(an.best.castle==INV_CAST) { // mated or stalemated
+        if(an.value<0.5f)
+            return string("[%eval #")+((pos.active==WT) ? "-0" : "0")+"]";
+        snprintf(buf,sizeof(buf),"[%%eval 0.00]");
+        return buf;
+    }
+    // expected score to pawns with the usual logistic scale, clamped to +-20
+    float v = min(max(an.value,0.001f),0.999f);
+    float pawns = -4*log10(1/v-1);
+    pawns = min(max(pawns,-20.0f),20.0f);
+    pawns = ((pos.active==WT) ? pawns : -pawns)+0.0f; // no "-0.00"
+    snprintf(buf,sizeof(buf),"[%%eval %.2f]",pawns);
+    return buf;
+}
+
+static void analyse(vector<ChessState>& positions, vector<Analysis>& results, uint32_t lo, uint32_t hi, MCTS& mcts) {
+    for(uint32_t i=lo; i<hi; i++) {
+        mcts.reseed(positions[i].hash()); // same analysis whichever worker gets the position
+        results[i].best = mcts.search(positions[i]);
+        results[i].value = mcts.value();
+    }
+}
+
+static void write_game(const PGNGame& pgame, const GamePositions& gp, const vector<Analysis>& results,
+        const AnnotateOptions& opts, ChessInterface& game, PGNWriter& pgn) {
+    for(auto& tg: pgame.tags)
+        pgn.tag(tg.first.c_str(),tg.second.c_str());
+    game.set_state(gp.start);
+    pgn.start(gp.start.fmove,gp.start.active);
+    minfo mv;
+    for(size_t ply=0; ply<pgame.moves.size(); ply++) {
+        if(ply+1>=gp.slots.size()||!game.parse_san(pgame.moves[ply].c_str(),mv)) { // past a replay error, moves are copied
+            pgn.move(pgame.moves[ply].c_str());
+            continue;
+        }
+        const Analysis& before = results[gp.slots[ply]];
+        const Analysis& after = results[gp.slots[ply+1]];
+        string san = game.to_san(mv);
+        string best = (before.best.castle!=INV_CAST) ? game.to_san(before.best) : "";
+        float lost = before.value-(1-after.value); // expected score the mover gave away
+        game.move(mv);
+        string comment = eval_text(game,after);
+        if(best!=san&&lost>=opts.mistake) {
+            san += (lost>=opts.blunder) ? "??" : "?";
+            comment += " best "+best;
+        }
+        pgn.move(san.c_str(),comment.c_str());
+    }
+    pgn.result(!pgame.result.empty() ? pgame.result.c_str() : pgame.tag("Result") ? pgame.tag("Result") : "*");
+}
+
+int main(int argc, char** argv) {
+    string out_path = "annotated.pgn";
+    uint32_t nthreads = thread::hardware_concurrency();
+    MCTSConfig cfg;
+    cfg.playouts = 400;
+    AnnotateOptions opts;
+    vector<string> paths;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--out"&&i+1<argc) out_path = argv[++i];
+        else if(opt=="--threads"&&i+1<argc) nthreads = atoi(argv[++i]);
+        else if(opt=="--playouts"&&i+1<argc) cfg.playouts = atoll(argv[++i]);
+        else if(opt=="--mistake"&&i+1<argc) opts.mistake = atof(argv[++i]);
+        else if(opt=="--blunder"&&i+1<argc) opts.blunder = atof(argv[++i]);
+        else if(opt=="--cache"&&i+1<argc) opts.cache = atoll(argv[++i]);
+        else if(opt[0]=='-') {
+            cerr << "usage: " << argv[0] << " [--out out.pgn] [--threads N] [--playouts N] [--mistake D] [--blunder D] [--cache N] file.pgn..." << endl;
+            return 1;
+        } else
+            paths.push_back(opt);
+    }
+    cfg.threads = 1; // positions run in parallel instead
+    cfg.max_nodes = min<uint64_t>(cfg.max_nodes,cfg.playouts*64);
+
+    ofstream fout(out_path);
+    if(!fout) {
+        cerr << "cannot write " << out_path << endl;
+        return 1;
+    }
+    auto stime = chrono::steady_clock::now();
+    ThreadPool pool(nthreads);
+    vector<MCTS*> engines; // one per worker
+    for(uint32_t w=0; w<pool.size(); w++)
+        engines.push_back(new MCTS(cfg));
+
+    unordered_map<uint64_t,Analysis> cache;
+    unordered_map<uint64_t,uint32_t> slot_of; // position hash to slot, per batch
+    vector<ChessState> positions; // slots to analyse
+    vector<Analysis> results;
+    vector<PGNGame> batch;
+    vector<GamePositions> gps;
+    ChessInterface game;
+    PGNWriter pgn;
+    uint64_t ngames = 0, nplies = 0, nanalysed = 0, ncached = 0;
+    minfo mv;
+    for(size_t f=0; f<=paths.size(); f++) {
+        ifstream fin;
+        if(f<paths.size()) {
+            fin.open(paths[f]);
+            if(!fin) {
+                cerr << "cannot open " << paths[f] << endl;
+                return 1;
+            }
+        }
+        PGNReader reader(fin);
+        while(true) {
+            bool more = f<paths.size();
+            if(more) {
+                batch.emplace_back();
+                more = reader.next(batch.back());
+                if(!more)
+                    batch.pop_back();
+            }
+            if(more&&batch.size()<BATCH_GAMES)
+                continue;
+            if(!more&&f<paths.size()) // next file
+                break;
+
+            // expand the batch into its distinct positions
+            slot_of.clear();
+            positions.clear();
+            gps.assign(batch.size(),GamePositions());
+            for(size_t g=0; g<batch.size(); g++) {
+                GamePositions& gp = gps[g];
+                try {
+                    gp.start = batch[g].tag("FEN") ? ChessState(batch[g].tag("FEN")) : ChessState();
+                } catch(const invalid_argument& e) {
+                    gp.error = true;
+                    continue;
+                }
+                game.set_state(gp.start);
+                for(size_t ply=0; ply<=batch[g].moves.size(); ply++) {
+                    uint64_t h = game.hash();
+                    auto it = slot_of.find(h);
+                    if(it==slot_of.end()) {
+                        it = slot_of.insert(make_pair(h,(uint32_t)positions.size())).first;
+                        positions.push_back(game);
+                    }
+                    gp.slots.push_back(it->second);
+                    if(ply==batch[g].moves.size())
+                        break;
+                    if(!game.parse_san(batch[g].moves[ply].c_str(),mv)) {
+                        gp.error = true;
+                        break;
+                    }
+                    game.move(mv);
+                }
+            }
+            results.assign(positions.size(),Analysis());
+            vector<uint32_t> todo;
+            for(uint32_t i=0; i<positions.size(); i++) {
+                auto it = cache.find(positions[i].hash());
+                if(it!=cache.end()) {
+                    results[i] = it->second;
+                    ncached++;
+                } else
+                    todo.push_back(i);
+            }
+            // positions that are not cached move to the front, so that jobs cover contiguous ranges
+            vector<ChessState> work;
+            work.reserve(todo.size());
+            for(uint32_t i: todo)
+                work.push_back(positions[i]);
+            vector<Analysis> done(work.size());
+            for(uint32_t lo=0, job=0; lo<work.size(); lo+=JOB_POSITIONS, job++) {
+                uint32_t hi = min<uint32_t>(lo+JOB_POSITIONS,work.size());
+                uint32_t worker = job%pool.size();
+                pool.submit(worker,[&work,&done,lo,hi,&engines,worker]() {
+                    analyse(work,done,lo,hi,*engines[worker]);
+                });
+            }
+            pool.wait();
+            for(size_t k=0; k<todo.size(); k++) {
+                results[todo[k]] = done[k];
+                if(cache.size()<opts.cache)
+                    cache[work[k].hash()] = done[k];
+            }
+            nanalysed += todo.size();
+
+            for(size_t g=0; g<batch.size(); g++) {
+                if(gps[g].slots.empty()) { // unreadable FEN, written without annotations
+                    for(auto& tg: batch[g].tags)
+                        pgn.tag(tg.first.c_str(),tg.second.c_str());
+                    pgn.start();
+                    for(const string& san: batch[g].moves)
+                        pgn.move(san.c_str());
+                    pgn.result(!batch[g].result.empty() ? batch[g].result.c_str() : "*");
+                } else
+                    write_game(batch[g],gps[g],results,opts,game,pgn);
+                pgn.flush(fout);
+                ngames++;
+                nplies += batch[g].moves.size();
+            }
+            batch.clear();
+            if(!more)
+                break;
+        }
+    }
+    for(MCTS* eng: engines)
+        delete eng;
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+    cerr << ngames << " games, " << nplies << " plies, " << nanalysed << " positions analysed, " << ncached
+        << " from the cache, " << secs << "s (" << (uint64_t)(nanalysed/secs) << " positions/s)" << endl;
+    return 0;
+}
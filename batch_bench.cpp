@@ -0,0 +1,191 @@
+#include "chess_interface.h"
+#include "pgn_reader.h"
+#include "position_batch.h"
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+
+// compares the PositionBatch kernels with the same queries on ChessState objects, on every position of PGN games:
+// batch_bench [--repeat N] file.pgn...
+// all three (objects, scalar batch, AVX2 batch) must agree, and every position must survive the FEN round trip
+
+struct Results {
+    vector<uint64_t> wattacks;
+    vector<uint64_t> battacks;
+    vector<uint8_t> check;
+    vector<uint16_t> mobility;
+    vector<int32_t> material;
+
+    void resize(size_t n) {
+        wattacks.resize(n);
+        battacks.resize(n);
+        check.resize(n);
+        mobility.resize(n);
+        material.resize(n);
+    }
+    bool operator==(const Results& o) const {
+        return wattacks==o.wattacks&&battacks==o.battacks&&check==o.check&&mobility==o.mobility&&material==o.material;
+    }
+};
+
+// the engine's piece directions (row, column), for attack sets built the way its move generators walk the board
+static const int8_t knight_steps[8][2] = {{-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1}};
+static const int8_t king_steps[8][2] = {{-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1}};
+static const int8_t diagonal_steps[4][2] = {{-1,-1},{-1,1},{1,-1},{1,1}};
+static const int8_t straight_steps[4][2] = {{-1,0},{0,-1},{0,1},{1,0}};
+
+static uint64_t limited_attacks(const ChessState& pos, uint8_t sq, const int8_t (*steps)[2], int nsteps) {
+    uint64_t att = 0;
+    for(int d=0; d<nsteps; d++) {
+        int r = sq/SZ+steps[d][0], c = sq%SZ+steps[d][1];
+        if(pos.at(r,c)!=INV)
+            att |= 1ULL<<(r*SZ+c);
+    }
+    return att;
+}
+
+static uint64_t sliding_attacks(const ChessState& pos, uint8_t sq, const int8_t (*steps)[2], int nsteps) {
+    // every empty square along each direction and the first piece that blocks it
+    uint64_t att = 0;
+    for(int d=0; d<nsteps; d++) {
+        int r = sq/SZ+steps[d][0], c = sq%SZ+steps[d][1];
+        uint8_t p;
+        while((p=pos.at(r,c))!=INV) {
+            att |= 1ULL<<(r*SZ+c);
+            if(p!=EMP)
+                break;
+            r += steps[d][0];
+            c += steps[d][1];
+        }
+    }
+    return att;
+}
+
+static uint64_t piece_attacks(const ChessState& pos, uint8_t piece, uint8_t sq) {
+    switch(IS_WHITE(piece) ? piece : piece-WK) {
+        case WP: {
+            static const int8_t pawn_steps[2][2][2] = {{{1,-1},{1,1}},{{-1,-1},{-1,1}}}; // black, white (towards row 0)
+            return limited_attacks(pos,sq,pawn_steps[IS_WHITE(piece)],2);
+        }
+        case WN: return limited_attacks(pos,sq,knight_steps,8);
+        case WB: return sliding_attacks(pos,sq,diagonal_steps,4);
+        case WR: return sliding_attacks(pos,sq,straight_steps,4);
+        case WQ: return sliding_attacks(pos,sq,diagonal_steps,4)|sliding_attacks(pos,sq,straight_steps,4);
+        default: return limited_attacks(pos,sq,king_steps,8);
+    }
+}
+
+static void object_queries(vector<ChessState>& positions, Results& res) {
+    // one ChessState at a time: walk each piece's moves from its squares, as the move generators do
+    static const int32_t values[INV] = {0,1,3,3,5,9,0,-1,-3,-3,-5,-9,0};
+    res.resize(positions.size());
+    for(size_t i=0; i<positions.size(); i++) {
+        ChessState& pos = positions[i];
+        uint64_t att[2] = {0,0};
+        uint64_t own = 0;
+        int32_t mat = 0;
+        for(uint8_t p=EMP+1; p<INV; p++) {
+            for(uint8_t sq: pos.psquares[p])
+                att[IS_WHITE(p) ? 0 : 1] |= piece_attacks(pos,p,sq);
+            if(IS_WHITE(p)==(pos.active==WT))
+                own |= pos.psquares[p].mask();
+            mat += values[p]*pos.psquares[p].size();
+        }
+        res.wattacks[i] = att[0];
+        res.battacks[i] = att[1];
+        res.check[i] = (att[(pos.active==WT) ? 1 : 0]>>*pos.psquares[(pos.active==WT) ? WK : BK].begin())&1;
+        res.mobility[i] = __builtin_popcountll(att[(pos.active==WT) ? 0 : 1]&~own);
+        res.material[i] = mat;
+    }
+}
+
+static void batch_queries(const PositionBatch& batch, Results& res) {
+    res.resize(batch.size());
+    batch.attacks(WT,res.wattacks.data());
+    batch.attacks(BT,res.battacks.data());
+    batch.in_check(res.check.data());
+    batch.mobility(res.mobility.data());
+    batch.material(res.material.data());
+}
+
+template<class F> static double timed(uint32_t repeat, F f) {
+    auto stime = chrono::steady_clock::now();
+    for(uint32_t r=0; r<repeat; r++)
+        f();
+    return chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+}
+
+int main(int argc, char** argv) {
+    uint32_t repeat = 10;
+    vector<string> paths;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--repeat"&&i+1<argc) repeat = max(1,atoi(argv[++i]));
+        else if(opt[0]=='-') {
+            cerr << "usage: " << argv[0] << " [--repeat N] file.pgn..." << endl;
+            return 1;
+        } else
+            paths.push_back(opt);
+    }
+    if(paths.empty()) {
+        cerr << "usage: " << argv[0] << " [--repeat N] file.pgn..." << endl;
+        return 1;
+    }
+
+    vector<ChessState> positions;
+    ChessInterface game;
+    PGNGame pgame;
+    for(const string& path: paths) {
+        ifstream fin(path);
+        if(!fin) {
+            cerr << "cannot open " << path << endl;
+            return 1;
+        }
+        PGNReader reader(fin);
+        while(reader.next(pgame)) {
+            try {
+                game.set_state(pgame.tag("FEN") ? ChessState(pgame.tag("FEN")) : ChessState());
+            } catch(const invalid_argument& e) {
+                continue;
+            }
+            positions.push_back(game);
+            for(const string& san: pgame.moves) {
+                if(!game.play_san(san.c_str()))
+                    break;
+                positions.push_back(game);
+            }
+        }
+    }
+
+    PositionBatch batch;
+    batch.reserve(positions.size());
+    for(const ChessState& pos: positions)
+        batch.push(pos);
+    for(size_t i=0; i<positions.size(); i++) {
+        if(batch.get_FEN(i)!=positions[i].get_FEN()) {
+            cerr << "FEN round trip failed: " << positions[i].get_FEN() << " became " << batch.get_FEN(i) << endl;
+            return 1;
+        }
+    }
+
+    Results objects, scalar, simd;
+    double tobj = timed(repeat,[&]() { object_queries(positions,objects); });
+    batch.simd = false;
+    double tscalar = timed(repeat,[&]() { batch_queries(batch,scalar); });
+    batch.simd = true;
+    double tsimd = timed(repeat,[&]() { batch_queries(batch,simd); });
+
+    double n = (double)positions.size()*repeat;
+    cout << positions.size() << " positions x " << repeat << endl;
+    cout << "objects: " << (uint64_t)(n/tobj) << " positions/s" << endl;
+    cout << "batch, scalar: " << (uint64_t)(n/tscalar) << " positions/s (" << tobj/tscalar << "x)" << endl;
+    if(PositionBatch::simd_available())
+        cout << "batch, AVX2: " << (uint64_t)(n/tsimd) << " positions/s (" << tobj/tsimd << "x)" << endl;
+    else
+        cout << "batch, AVX2: not available on this CPU" << endl;
+    if(!(scalar==objects)||!(simd==objects)) {
+        cerr << "batch results differ from ChessState" << endl;
+        return 1;
+    }
+    return 0;
+}
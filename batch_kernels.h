@@ -0,0 +1,136 @@
+#ifndef BATCH_KERNELS_H
+#define BATCH_KERNELS_H
+#include <cstdint>
+#include <cstddef>
+
+// bitboard kernels of PositionBatch, written once over a lane type: Ops::V holds the same column of Ops::WIDTH positions
+// included by position_batch.cpp (scalar lanes) and position_batch_avx2.cpp (compiled with -mavx2). The kernels are
+// inline templates over Ops in an unnamed namespace: each file instantiates its own copies with its own Ops type
+// (ScalarOps, AVX2Ops), so the linker never has to pick one. A helper added here must stay such a template: a plain
+// inline function would be compiled in both files, and the linker could pick the -mavx2 copy for the scalar path
+
+#define BB_NOT_A 0xFEFEFEFEFEFEFEFEULL // every square but the a-file
+#define BB_NOT_AB 0xFCFCFCFCFCFCFCFCULL
+#define BB_NOT_H 0x7F7F7F7F7F7F7F7FULL
+#define BB_NOT_GH 0x3F3F3F3F3F3F3F3FULL
+
+struct BatchView { // columns of a PositionBatch
+    const uint64_t* pieces[12]; // bitboard per piece, index piece-1 (WP..BK), bit i is square i (a8=0..h1=63)
+    const uint64_t* white; // all ones when white is to move
+};
+
+namespace {
+
+// shift towards higher squares for S>0 (south: +8, east: +1), keeping the squares in M
+template<class Ops, int S, uint64_t M> inline typename Ops::V step(typename Ops::V a) {
+    typedef typename Ops::V V;
+    V moved = (S>0) ? Ops::template shl<(S>0 ? S : 0)>(a) : Ops::template shr<(S<0 ? -S : 0)>(a);
+    return (M==~0ULL) ? moved : Ops::and_(moved,Ops::set1(M));
+}
+
+// sliding attacks in one direction, Kogge-Stone fill through the empty squares
+template<class Ops, int S, uint64_t M> inline typename Ops::V ray(typename Ops::V gen, typename Ops::V empty) {
+    typedef typename Ops::V V;
+    V pro = Ops::and_(empty,Ops::set1(M));
+    gen = Ops::or_(gen,Ops::and_(pro,step<Ops,S,~0ULL>(gen)));
+    pro = Ops::and_(pro,step<Ops,S,~0ULL>(pro));
+    gen = Ops::or_(gen,Ops::and_(pro,step<Ops,2*S,~0ULL>(gen)));
+    pro = Ops::and_(pro,step<Ops,2*S,~0ULL>(pro));
+    gen = Ops::or_(gen,Ops::and_(pro,step<Ops,4*S,~0ULL>(gen)));
+    return step<Ops,S,M>(gen);
+}
+
+// squares attacked by one side, bb: its pawns, knights, bishops, rooks, queens, king
+template<class Ops, bool WHITE> inline typename Ops::V side_attacks(const typename Ops::V* bb, typename Ops::V empty) {
+    typedef typename Ops::V V;
+    V att = WHITE ? Ops::or_(step<Ops,-7,BB_NOT_A>(bb[0]),step<Ops,-9,BB_NOT_H>(bb[0]))
+                  : Ops::or_(step<Ops,9,BB_NOT_A>(bb[0]),step<Ops,7,BB_NOT_H>(bb[0]));
+    V n = bb[1];
+    att = Ops::or_(att,Ops::or_(Ops::or_(step<Ops,-17,BB_NOT_H>(n),step<Ops,-15,BB_NOT_A>(n)),
+                                Ops::or_(step<Ops,-10,BB_NOT_GH>(n),step<Ops,-6,BB_NOT_AB>(n))));
+    att = Ops::or_(att,Ops::or_(Ops::or_(step<Ops,6,BB_NOT_GH>(n),step<Ops,10,BB_NOT_AB>(n)),
+                                Ops::or_(step<Ops,15,BB_NOT_H>(n),step<Ops,17,BB_NOT_A>(n))));
+    V k = bb[5];
+    att = Ops::or_(att,Ops::or_(Ops::or_(step<Ops,-8,~0ULL>(k),step<Ops,8,~0ULL>(k)),
+                                Ops::or_(step<Ops,1,BB_NOT_A>(k),step<Ops,-1,BB_NOT_H>(k))));
+    att = Ops::or_(att,Ops::or_(Ops::or_(step<Ops,-7,BB_NOT_A>(k),step<Ops,-9,BB_NOT_H>(k)),
+                                Ops::or_(step<Ops,9,BB_NOT_A>(k),step<Ops,7,BB_NOT_H>(k))));
+    V diag = Ops::or_(bb[2],bb[4]);
+    att = Ops::or_(att,Ops::or_(Ops::or_(ray<Ops,-7,BB_NOT_A>(diag,empty),ray<Ops,-9,BB_NOT_H>(diag,empty)),
+                                Ops::or_(ray<Ops,9,BB_NOT_A>(diag,empty),ray<Ops,7,BB_NOT_H>(diag,empty))));
+    V orth = Ops::or_(bb[3],bb[4]);
+    att = Ops::or_(att,Ops::or_(Ops::or_(ray<Ops,-8,~0ULL>(orth,empty),ray<Ops,8,~0ULL>(orth,empty)),
+                                Ops::or_(ray<Ops,1,BB_NOT_A>(orth,empty),ray<Ops,-1,BB_NOT_H>(orth,empty))));
+    return att;
+}
+
+template<class Ops> inline void load_position(const BatchView& b, size_t i, typename Ops::V* bb, typename Ops::V& occ) {
+    occ = Ops::set1(0);
+    for(int p=0; p<12; p++) {
+        bb[p] = Ops::load(b.pieces[p]+i);
+        occ = Ops::or_(occ,bb[p]);
+    }
+}
+
+// the loops cover [lo,hi), hi-lo a multiple of Ops::WIDTH
+
+template<class Ops> inline void attacks_loop(const BatchView& b, bool white, size_t lo, size_t hi, uint64_t* out) {
+    typename Ops::V bb[12], occ;
+    for(size_t i=lo; i<hi; i+=Ops::WIDTH) {
+        load_position<Ops>(b,i,bb,occ);
+        typename Ops::V empty = Ops::andnot(occ,Ops::set1(~0ULL));
+        Ops::store(out+i,white ? side_attacks<Ops,true>(bb,empty) : side_attacks<Ops,false>(bb+6,empty));
+    }
+}
+
+template<class Ops> inline void check_loop(const BatchView& b, size_t lo, size_t hi, uint8_t* out) {
+    typename Ops::V bb[12], occ;
+    for(size_t i=lo; i<hi; i+=Ops::WIDTH) {
+        load_position<Ops>(b,i,bb,occ);
+        typename Ops::V empty = Ops::andnot(occ,Ops::set1(~0ULL));
+        typename Ops::V white = Ops::load(b.white+i);
+        typename Ops::V by_white = Ops::and_(side_attacks<Ops,true>(bb,empty),bb[11]);
+        typename Ops::V by_black = Ops::and_(side_attacks<Ops,false>(bb+6,empty),bb[5]);
+        Ops::store_nonzero(out+i,Ops::or_(Ops::and_(white,by_black),Ops::andnot(white,by_white)));
+    }
+}
+
+template<class Ops> inline void mobility_loop(const BatchView& b, size_t lo, size_t hi, uint16_t* out) {
+    typename Ops::V bb[12], occ;
+    for(size_t i=lo; i<hi; i+=Ops::WIDTH) {
+        load_position<Ops>(b,i,bb,occ);
+        typename Ops::V empty = Ops::andnot(occ,Ops::set1(~0ULL));
+        typename Ops::V white = Ops::load(b.white+i);
+        typename Ops::V wocc = bb[0], bocc = bb[6];
+        for(int p=1; p<6; p++) {
+            wocc = Ops::or_(wocc,bb[p]);
+            bocc = Ops::or_(bocc,bb[6+p]);
+        }
+        typename Ops::V wmob = Ops::andnot(wocc,side_attacks<Ops,true>(bb,empty));
+        typename Ops::V bmob = Ops::andnot(bocc,side_attacks<Ops,false>(bb+6,empty));
+        Ops::store_u16(out+i,Ops::popcount(Ops::or_(Ops::and_(white,wmob),Ops::andnot(white,bmob))));
+    }
+}
+
+template<class Ops> inline void material_loop(const BatchView& b, size_t lo, size_t hi, int32_t* out) {
+    typedef typename Ops::V V;
+    for(size_t i=lo; i<hi; i+=Ops::WIDTH) {
+        V cnt[12];
+        for(int p=0; p<12; p++)
+            cnt[p] = Ops::popcount(Ops::load(b.pieces[p]+i));
+        // P=1, N=B=3, R=5, Q=9 with shifts and adds, per side
+        V side[2];
+        for(int s=0; s<2; s++) {
+            const V* c = cnt+6*s;
+            V minors = Ops::add(c[1],c[2]);
+            side[s] = Ops::add(c[0],Ops::add(minors,Ops::template shl<1>(minors)));
+            side[s] = Ops::add(side[s],Ops::add(c[3],Ops::template shl<2>(c[3])));
+            side[s] = Ops::add(side[s],Ops::add(c[4],Ops::template shl<3>(c[4])));
+        }
+        Ops::store_i32(out+i,Ops::sub(side[0],side[1]));
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef BOARD_POLICIES_H
+#define BOARD_POLICIES_H
+#include "chess_types.h"
+#include "square_set.h"
+#include <cstring>
+
+// board representations for BasicChessState, chosen at compile time. Every policy provides:
+//   get(sq): piece on a square, at(r,c): same by row and column, INV off the board
+//   put(sq,piece) on an empty square, remove(sq) of a piece, clear()
+//   squares(piece): the squares of a piece in ascending order (iterable), count(piece)
+//   targets(sq): mask of the empty or enemy squares the knight, bishop, rook, queen or king on sq attacks
+//   attacked(sq,white): is sq attacked by a piece of that color
+// BitboardBoard is the one behind ChessState, the others are for comparing layouts (see perft)
+
+// (row, column) steps, row 0 is black's back rank. The king's are also the ray directions: diagonals first
+static const int8_t knight_offsets[8][2] = {{-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1}};
+static const int8_t king_offsets[8][2] = {{-1,-1},{-1,1},{1,-1},{1,1},{-1,0},{0,-1},{0,1},{1,0}};
+
+template<class Derived>
+class RayAttacks { // the attack hooks of the layouts without masks: steps and rays are walked through at()
+    public:
+        uint64_t targets(uint8_t sq) const {
+            const Derived& b = static_cast<const Derived&>(*this);
+            uint8_t piece = b.get(sq);
+            bool white = IS_WHITE(piece);
+            uint8_t type = white ? piece : piece-WK;
+            int r = sq/SZ, c = sq%SZ;
+            uint64_t found = 0;
+            if(type==WN||type==WK) {
+                const int8_t (*steps)[2] = (type==WN) ? knight_offsets : king_offsets;
+                for(int d=0; d<8; d++) {
+                    int r2 = r+steps[d][0], c2 = c+steps[d][1];
+                    uint8_t p = b.at(r2,c2);
+                    if(p==EMP||(p!=INV&&IS_WHITE(p)!=white))
+                        found |= 1ULL<<(r2*SZ+c2);
+                }
+                return found;
+            }
+            for(int d=(type==WR) ? 4 : 0; d<((type==WB) ? 4 : 8); d++) {
+                int r2 = r+king_offsets[d][0], c2 = c+king_offsets[d][1];
+                uint8_t p;
+                while((p=b.at(r2,c2))==EMP) {
+                    found |= 1ULL<<(r2*SZ+c2);
+                    r2 += king_offsets[d][0];
+                    c2 += king_offsets[d][1];
+                }
+                if(p!=INV&&IS_WHITE(p)!=white) // capture
+                    found |= 1ULL<<(r2*SZ+c2);
+            }
+            return found;
+        }
+        bool attacked(uint8_t sq, bool white) const {
+            // from sq outwards, to the squares an attacker would stand on
+            const Derived& b = static_cast<const Derived&>(*this);
+            uint8_t off = white ? 0 : WK; // WP+off is the attacker's pawn
+            int r = sq/SZ, c = sq%SZ;
+            int pr = white ? r+1 : r-1; // white pawns capture towards row 0
+            if(b.at(pr,c-1)==WP+off||b.at(pr,c+1)==WP+off)
+                return true;
+            for(int d=0; d<8; d++) {
+                if(b.at(r+knight_offsets[d][0],c+knight_offsets[d][1])==WN+off||b.at(r+king_offsets[d][0],c+king_offsets[d][1])==WK+off)
+                    return true;
+            }
+            for(int d=0; d<8; d++) {
+                int r2 = r+king_offsets[d][0], c2 = c+king_offsets[d][1];
+                uint8_t p;
+                while((p=b.at(r2,c2))==EMP) {
+                    r2 += king_offsets[d][0];
+                    c2 += king_offsets[d][1];
+                }
+                if(p==WQ+off||p==((d<4) ? WB : WR)+off)
+                    return true;
+            }
+            return false;
+        }
+};
+
+class BitboardBoard { // a SquareSet per piece and an occupancy mask per color, plus a mailbox for square lookups
+    public:
+        uint8_t board[SZ][SZ];
+        SquareSet psquares[INV]; // where are the pieces located?
+        uint64_t colors[2]; // occupied squares, colors[WT] white's and colors[BT] black's
+
+        uint8_t get(uint8_t sq) const { return board[sq/SZ][sq%SZ]; }
+        uint8_t at(int r, int c) const { return ELEM(board,r,c); }
+        void put(uint8_t sq, uint8_t piece) {
+            board[sq/SZ][sq%SZ] = piece;
+            psquares[piece].insert(sq);
+            colors[IS_WHITE(piece)] |= 1ULL<<sq;
+        }
+        void remove(uint8_t sq) {
+            uint8_t piece = board[sq/SZ][sq%SZ];
+            psquares[piece].erase(sq);
+            colors[IS_WHITE(piece)] &= ~(1ULL<<sq);
+            board[sq/SZ][sq%SZ] = EMP;
+        }
+        void clear() {
+            memset(board,EMP,sizeof(board));
+            for(int p=0; p<INV; p++)
+                psquares[p].clear();
+            colors[0] = colors[1] = 0;
+        }
+        const SquareSet& squares(uint8_t piece) const { return psquares[piece]; }
+        uint8_t count(uint8_t piece) const { return psquares[piece].size(); }
+
+        uint64_t targets(uint8_t sq) const {
+            uint8_t piece = get(sq);
+            bool white = IS_WHITE(piece);
+            uint64_t occ = colors[0]|colors[1];
+            uint64_t found;
+            switch(white ? piece : piece-WK) {
+                case WN: found = knight_masks[sq]; break;
+                case WB: found = diagonal_attacks(sq,occ); break;
+                case WR: found = straight_attacks(sq,occ); break;
+                case WQ: found = diagonal_attacks(sq,occ)|straight_attacks(sq,occ); break;
+                default: found = king_masks[sq];
+            }
+            return found&~colors[white];
+        }
+        bool attacked(uint8_t sq, bool white) const {
+            uint8_t off = white ? 0 : WK; // WP+off is the attacker's pawn
+            uint64_t occ = colors[0]|colors[1];
+            uint64_t queens = psquares[WQ+off].mask();
+            // an attacking pawn stands where a pawn of the other color on sq would capture
+            return (pawn_masks[!white][sq]&psquares[WP+off].mask())||(knight_masks[sq]&psquares[WN+off].mask())
+                ||(king_masks[sq]&psquares[WK+off].mask())||(diagonal_attacks(sq,occ)&(psquares[WB+off].mask()|queens))
+                ||(straight_attacks(sq,occ)&(psquares[WR+off].mask()|queens));
+        }
+
+    private:
+        // filled in chess_state.cpp, rays[d][sq] are the squares from sq in direction king_offsets[d], sq excluded
+        static uint64_t knight_masks[SZ*SZ];
+        static uint64_t king_masks[SZ*SZ];
+        static uint64_t pawn_masks[2][SZ*SZ]; // [color][sq]: the two squares a pawn captures on
+        static uint64_t rays[8][SZ*SZ];
+        static bool masks_filled;
+        static bool fill_masks();
+
+        static uint64_t ray_attacks(int d, uint8_t sq, uint64_t occ) {
+            // up to the first piece on the ray, included
+            uint64_t ray = rays[d][sq];
+            uint64_t blockers = ray&occ;
+            if(blockers) // the first blocker is the lowest square on rays that go up, the highest on the others
+                ray ^= rays[d][(king_offsets[d][0]*SZ+king_offsets[d][1]>0) ? __builtin_ctzll(blockers) : 63-__builtin_clzll(blockers)];
+            return ray;
+        }
+        static uint64_t diagonal_attacks(uint8_t sq, uint64_t occ) {
+            return ray_attacks(0,sq,occ)|ray_attacks(1,sq,occ)|ray_attacks(2,sq,occ)|ray_attacks(3,sq,occ);
+        }
+        static uint64_t straight_attacks(uint8_t sq, uint64_t occ) {
+            return ray_attacks(4,sq,occ)|ray_attacks(5,sq,occ)|ray_attacks(6,sq,occ)|ray_attacks(7,sq,occ);
+        }
+};
+
+class MailboxBoard: public RayAttacks<MailboxBoard> { // the 8x8 array alone, piece squares are found by scanning it
+    public:
+        uint8_t get(uint8_t sq) const { return cells[sq/SZ][sq%SZ]; }
+        uint8_t at(int r, int c) const { return ELEM(cells,r,c); }
+        void put(uint8_t sq, uint8_t piece) { cells[sq/SZ][sq%SZ] = piece; }
+        void remove(uint8_t sq) { cells[sq/SZ][sq%SZ] = EMP; }
+        void clear() { memset(cells,EMP,sizeof(cells)); }
+        SquareSet squares(uint8_t piece) const {
+            SquareSet found;
+            for(uint8_t sq=0; sq<SZ*SZ; sq++)
+                if(cells[sq/SZ][sq%SZ]==piece)
+                    found.insert(sq);
+            return found;
+        }
+        uint8_t count(uint8_t piece) const { return squares(piece).size(); }
+
+    private:
+        uint8_t cells[SZ][SZ];
+};
+
+#define PLIST_MAX 10 // pieces of one kind: two, plus eight promotions
+
+class PieceLists { // a sorted array of squares per piece
+    public:
+        struct Range {
+            const uint8_t* first;
+            const uint8_t* last;
+            const uint8_t* begin() const { return first; }
+            const uint8_t* end() const { return last; }
+        };
+
+        void insert(uint8_t piece, uint8_t sq) {
+            uint8_t* list = sqs[piece];
+            uint8_t n = num[piece]++;
+            for(; n>0&&list[n-1]>sq; n--)
+                list[n] = list[n-1];
+            list[n] = sq;
+        }
+        void erase(uint8_t piece, uint8_t sq) {
+            uint8_t* list = sqs[piece];
+            uint8_t i = 0;
+            while(list[i]!=sq)
+                i++;
+            for(num[piece]--; i<num[piece]; i++)
+                list[i] = list[i+1];
+        }
+        void clear() { memset(num,0,sizeof(num)); }
+        Range squares(uint8_t piece) const { return Range{sqs[piece],sqs[piece]+num[piece]}; }
+        uint8_t count(uint8_t piece) const { return num[piece]; }
+
+    private:
+        uint8_t sqs[INV][PLIST_MAX];
+        uint8_t num[INV];
+};
+
+class PieceListBoard: public RayAttacks<PieceListBoard> { // the 8x8 array with a piece list per piece
+    public:
+        uint8_t get(uint8_t sq) const { return cells[sq/SZ][sq%SZ]; }
+        uint8_t at(int r, int c) const { return ELEM(cells,r,c); }
+        void put(uint8_t sq, uint8_t piece) {
+            cells[sq/SZ][sq%SZ] = piece;
+            lists.insert(piece,sq);
+        }
+        void remove(uint8_t sq) {
+            lists.erase(cells[sq/SZ][sq%SZ],sq);
+            cells[sq/SZ][sq%SZ] = EMP;
+        }
+        void clear() {
+            memset(cells,EMP,sizeof(cells));
+            lists.clear();
+        }
+        PieceLists::Range squares(uint8_t piece) const { return lists.squares(piece); }
+        uint8_t count(uint8_t piece) const { return lists.count(piece); }
+
+    private:
+        uint8_t cells[SZ][SZ];
+        PieceLists lists;
+};
+
+class X88Board: public RayAttacks<X88Board> { // 0x88: 16 columns per row, the right half and anything past the board have a bit of 0x88 set
+    public:
+        uint8_t get(uint8_t sq) const { return cells[sq+(sq&~(SZ-1))]; }
+        uint8_t at(int r, int c) const {
+            int s = 2*SZ*r+c;
+            return (s&~0x77) ? INV : cells[s]; // one test for all four edges
+        }
+        void put(uint8_t sq, uint8_t piece) {
+            cells[sq+(sq&~(SZ-1))] = piece;
+            lists.insert(piece,sq);
+        }
+        void remove(uint8_t sq) {
+            lists.erase(get(sq),sq);
+            cells[sq+(sq&~(SZ-1))] = EMP;
+        }
+        void clear() {
+            memset(cells,EMP,sizeof(cells));
+            lists.clear();
+        }
+        PieceLists::Range squares(uint8_t piece) const { return lists.squares(piece); }
+        uint8_t count(uint8_t piece) const { return lists.count(piece); }
+
+    private:
+        uint8_t cells[2*SZ*SZ];
+        PieceLists lists;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "chess_interface.h"
+#include "pgn_reader.h"
+#include "polyglot.h"
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <cstdlib>
+
+// builds and probes Polyglot opening books:
+// book build [--out book.bin] [--plies N] [--min-games K] [--randoms pg_key.c] file.pgn...
+// book probe [--book book.bin] [--fen FEN] [--moves "e4 e5 ..."] [--randoms pg_key.c]
+// a move gets weight 2 for every win and 1 for every draw of the side that played it, moves that never scored are dropped
+
+struct BookMove {
+    uint64_t key;
+    uint16_t move;
+    bool operator==(const BookMove& other) const { return key==other.key&&move==other.move; }
+};
+struct BookMoveHash {
+    size_t operator()(const BookMove& bm) const { return bm.key^((uint64_t)bm.move*0x9E3779B97F4A7C15ULL); }
+};
+struct BookStats {
+    uint32_t games = 0;
+    uint32_t score = 0; // 2 per win, 1 per draw
+};
+
+static int build(const vector<string>& paths, const string& out, uint32_t plies, uint32_t min_games) {
+    unordered_map<BookMove,BookStats,BookMoveHash> stats;
+    ChessInterface game;
+    ChessState start;
+    PGNGame pgame;
+    minfo mv;
+    uint64_t ngames = 0;
+    for(const string& path: paths) {
+        ifstream fin(path);
+        if(!fin) {
+            cerr << "cannot open " << path << endl;
+            return 1;
+        }
+        PGNReader reader(fin);
+        while(reader.next(pgame)) {
+            string res = pgame.result.empty()&&pgame.tag("Result") ? pgame.tag("Result") : pgame.result;
+            int8_t white_score = (res=="1-0") ? 2 : (res=="0-1") ? 0 : (res=="1/2-1/2") ? 1 : -1;
+            if(white_score<0||pgame.tag("FEN")) // unfinished games and games from other positions say nothing about openings
+                continue;
+            game.set_state(start);
+            ngames++;
+            for(size_t ply=0; ply<pgame.moves.size()&&ply<plies; ply++) {
+                if(!game.parse_san(pgame.moves[ply].c_str(),mv))
+                    break;
+                BookStats& st = stats[BookMove{polyglot_key(game),polyglot_move(game,mv)}];
+                st.games++;
+                st.score += (game.active==WT) ? white_score : 2-white_score;
+                game.move(mv);
+            }
+        }
+    }
+
+    vector<PolyglotEntry> entries;
+    uint32_t max_score = 1;
+    for(auto& kv: stats)
+        if(kv.second.games>=min_games)
+            max_score = max(max_score,kv.second.score);
+    for(auto& kv: stats) {
+        if(kv.second.games<min_games||kv.second.score==0)
+            continue;
+        PolyglotEntry ent;
+        ent.key = kv.first.key;
+        ent.move = kv.first.move;
+        // weights are 16 bits, scale down the most played lines
+        ent.weight = (max_score<=0xFFFF) ? kv.second.score : max((uint64_t)1,(uint64_t)kv.second.score*0xFFFF/max_score);
+        ent.learn = 0;
+        entries.push_back(ent);
+    }
+    polyglot_write(out,entries);
+    cout << ngames << " games, " << stats.size() << " position moves, " << entries.size() << " book entries in " << out << endl;
+    return 0;
+}
+
+static int probe(const string& path, const string& fen, const string& moves) {
+    PolyglotBook book(path);
+    ChessInterface game;
+    if(!fen.empty())
+        game.set_state(ChessState(fen));
+    stringstream ss(moves);
+    string san;
+    while(ss >> san) {
+        if(!game.play_san(san.c_str())) {
+            cerr << "illegal move " << san << endl;
+            return 1;
+        }
+    }
+    uint64_t key = polyglot_key(game);
+    vector<PolyglotEntry> entries;
+    book.probe(key,entries);
+    uint64_t total = 0;
+    for(const PolyglotEntry& ent: entries)
+        total += ent.weight;
+    cout << game.get_FEN() << endl << "key " << hex << key << dec << ", " << entries.size() << " book moves" << endl;
+    minfo mv;
+    for(const PolyglotEntry& ent: entries) {
+        if(!polyglot_minfo(game,ent.move,mv))
+            continue; // hash collision
+        cout << game.to_san(mv) << " " << ent.weight << " (" << 100.0*ent.weight/total << "%)" << endl;
+    }
+    mt19937_64 rng(random_device{}());
+    if(book.pick(game,mv,rng))
+        cout << "pick " << game.to_san(mv) << endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    string cmd = (argc>1) ? argv[1] : "";
+    string out = "book.bin";
+    string fen;
+    string moves;
+    uint32_t plies = 20;
+    uint32_t min_games = 1;
+    vector<string> paths;
+    if(!polyglot_official()) {
+        cerr << "the built-in Polyglot table does not give the starting position key" << endl;
+        return 1;
+    }
+    for(int i=2; i<argc; i++) {
+        string opt = argv[i];
+        if((opt=="--out"||opt=="--book")&&i+1<argc) out = argv[++i];
+        else if(opt=="--plies"&&i+1<argc) plies = atoi(argv[++i]);
+        else if(opt=="--min-games"&&i+1<argc) min_games = atoi(argv[++i]);
+        else if(opt=="--fen"&&i+1<argc) fen = argv[++i];
+        else if(opt=="--moves"&&i+1<argc) moves = argv[++i];
+        else if(opt=="--randoms"&&i+1<argc) {
+            if(!polyglot_load_randoms(argv[++i])) {
+                cerr << "cannot read " << POLYGLOT_RANDOMS << " random numbers from " << argv[i] << endl;
+                return 1;
+            }
+            if(!polyglot_official())
+                cerr << "warning: " << argv[i] << " does not give the Polyglot starting position key" << endl;
+        } else if(opt[0]=='-') {
+            cmd.clear();
+            break;
+        } else
+            paths.push_back(opt);
+    }
+    try {
+        if(cmd=="build")
+            return build(paths,out,plies,min_games);
+        if(cmd=="probe")
+            return probe(out,fen,moves);
+    } catch(const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    cerr << "usage: " << argv[0] << " build [--out book.bin] [--plies N] [--min-games K] [--randoms pg_key.c] file.pgn..." << endl
+        << "       " << argv[0] << " probe [--book book.bin] [--fen FEN] [--moves \"e4 e5\"] [--randoms pg_key.c]" << endl;
+    return 1;
+}
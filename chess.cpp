@@ -1,7 +1,78 @@
 #include "chess_interface.h"
+#include "chess_stats.h"
+#include "ponder.h"
 #include <sstream>
-int main() {
+#include <cstring>
+#include <cstdlib>
+
+static bool stats_json = false;
+static void print_stats() {
+    ChessStats::print(cerr,stats_json);
+}
+
+static void play_engine(ChessInterface& cgame, bool engine_side, const MCTSConfig& cfg, bool ponder) {
+    // the human moves through one_play_input, the engine answers with MCTS
+    // with ponder, the engine searches the expected reply while waiting for the human's move
+    MCTS mcts(cfg);
+    Ponderer ponderer(mcts);
+    while(cgame.get_state()==NORMAL||cgame.get_state()==CHECK) {
+        if(cgame.active==engine_side) {
+            minfo mv;
+            if(ponderer.finish(cgame,mv))
+                cout << "ponder hit" << endl;
+            else
+                mv = mcts.search(cgame);
+            cout << "engine plays " << cgame.to_san(mv) << " (" << mcts.playouts() << " playouts)" << endl;
+            cgame.move(mv);
+            if(ponder&&cgame.has_legal_move()&&ponderer.start(cgame))
+                cout << "pondering on " << cgame.to_san(ponderer.expected()) << endl;
+            continue;
+        }
+        try {
+            if(!cgame.one_play_input())
+                return;
+        } catch(const invalid_argument& e) {
+            cout << e.what() << endl;
+        }
+    }
+    ponderer.cancel();
+    cgame.print_board();
+}
+
+int main(int argc, char** argv) {
+    // --stats: print per-phase call counts and times to stderr at exit (--stats=json for JSON)
+    // --engine white|black: play against MCTS, --ponder: search on the human's time
+    bool engine = false;
+    bool engine_side = BT;
+    bool ponder = false;
+    MCTSConfig cfg;
+    for(int i=1; i<argc; i++) {
+        if(strcmp(argv[i],"--stats")==0||strcmp(argv[i],"--stats=json")==0) {
+            ChessStats::enabled = true;
+            stats_json = (strcmp(argv[i],"--stats=json")==0);
+            atexit(print_stats);
+        } else if(strcmp(argv[i],"--engine")==0&&i+1<argc&&(strcmp(argv[i+1],"white")==0||strcmp(argv[i+1],"black")==0)) {
+            engine = true;
+            engine_side = (strcmp(argv[++i],"white")==0) ? WT : BT;
+        } else if(strcmp(argv[i],"--ponder")==0)
+            ponder = true;
+        else if(strcmp(argv[i],"--playouts")==0&&i+1<argc)
+            cfg.playouts = atoll(argv[++i]);
+        else if(strcmp(argv[i],"--millis")==0&&i+1<argc) {
+            cfg.millis = atoi(argv[++i]);
+            cfg.playouts = UINT64_MAX;
+        } else if(strcmp(argv[i],"--threads")==0&&i+1<argc)
+            cfg.threads = atoi(argv[++i]);
+        else {
+            cerr << "usage: " << argv[0] << " [--stats|--stats=json] [--engine white|black [--ponder] [--playouts N] [--millis N] [--threads N]]" << endl;
+            return 1;
+        }
+    }
     ChessInterface cgame;
+    if(engine) {
+        play_engine(cgame,engine_side,cfg,ponder);
+        return 0;
+    }
 
     // string gmstr = "e4 d5 d3 dxe4 dxe4 Qxd1+ Kxd1 Nc6 Bd3 Bg4+ f3 Bh5 Be3 Bg6 Ke2 O-O-O Nc3 Nd4+ Kd2 e5 Bxd4 exd4 Nd5 Ne7 Nxe7+ Bxe7 Nh3 Bb4+ c3 dxc3+ bxc3 Ba5 a4 Rd7 Kc2 Rhd8 c4 Rxd3 Nf4 Rd2+ Kb3 f5 exf5 Bxf5 Rac1 g5 Nd5 c6 Nc3 Bxc3 Rxc3 Rxg2 Re1 Rgd2 Re5 Bg6 Rxg5 R2d3 Rxd3 Rxd3+ Kb4 Rxf3 h4 Rh3 Rg4 Bh5 Rg8+ Kd7 Rg7+ Ke6 Rxb7 Rxh4 Rxa7 Bg6 Ra6 Kd7 Ra7+ Kc8 Ra8+ Kb7 Rf8 Bd3";
     // stringstream ss(gmstr);
@@ -13,4 +84,4 @@ int main() {
 
     cgame.play_input();
     return 0;
-}
\ No newline at end of file
+}
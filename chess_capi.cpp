@@ -0,0 +1,137 @@
+#include "chess_interface.h"
+#include "chess_capi.h"
+#include <cstring>
+
+struct chess_position {
+    ChessInterface game;
+    vector<minfo> moves; // chess_legal_moves scratch list
+};
+
+static int copy_out(const char* str, size_t slen, char* buf, size_t len) {
+    // snprintf-like: writes what fits, returns the full length
+    if(len>0) {
+        size_t n = (slen<len) ? slen : len-1;
+        memcpy(buf,str,n);
+        buf[n] = 0;
+    }
+    return (int)slen;
+}
+
+static int apply_line(chess_position* pos, const char* moves, bool san) {
+    int applied = 0;
+    char mv[SAN_MAX];
+    while(*moves) {
+        while(*moves==' ')
+            moves++;
+        size_t len = strcspn(moves," ");
+        if(len==0)
+            break;
+        if(len>=SAN_MAX)
+            return applied;
+        memcpy(mv,moves,len);
+        mv[len] = 0;
+        if(!(san ? pos->game.play_san(mv) : pos->game.play_uci(mv)))
+            return applied;
+        applied++;
+        moves += len;
+    }
+    return applied;
+}
+
+extern "C" {
+
+chess_position* chess_new(void) {
+    try {
+        return new chess_position();
+    } catch(...) {
+        return NULL;
+    }
+}
+
+void chess_free(chess_position* pos) {
+    delete pos;
+}
+
+int chess_load_fen(chess_position* pos, const char* fen) {
+    try {
+        pos->game.set_state(ChessState(string(fen)));
+        return 0;
+    } catch(...) {
+        return -1;
+    }
+}
+
+int chess_apply_san(chess_position* pos, const char* const* moves, int n) {
+    for(int i=0; i<n; i++) {
+        if(!pos->game.play_san(moves[i]))
+            return i;
+    }
+    return n;
+}
+
+int chess_apply_uci(chess_position* pos, const char* const* moves, int n) {
+    for(int i=0; i<n; i++) {
+        if(!pos->game.play_uci(moves[i]))
+            return i;
+    }
+    return n;
+}
+
+int chess_apply_san_line(chess_position* pos, const char* moves) {
+    return apply_line(pos,moves,true);
+}
+
+int chess_apply_uci_line(chess_position* pos, const char* moves) {
+    return apply_line(pos,moves,false);
+}
+
+int chess_legal_moves(chess_position* pos, uint16_t* moves, int cap) {
+    vector<minfo>& list = pos->moves;
+    list.clear();
+    pos->game.all_legal_moves(list);
+    for(int i=0; i<(int)list.size()&&i<cap; i++) {
+        const minfo& mv = list[i];
+        uint16_t promo = 0;
+        if(mv.newp!=pos->game.get(mv.sq1)) // a pawn becomes newp: WN..WQ (or BN..BQ) are 1..4
+            promo = (IS_WHITE(mv.newp) ? mv.newp : mv.newp-WK)-WP;
+        moves[i] = mv.sq1 | (mv.sq2<<6) | (promo<<12);
+    }
+    return (int)list.size();
+}
+
+int chess_legal_moves_san(chess_position* pos, char* buf, size_t len) {
+    string out;
+    for(const note& nt: pos->game.notes()) {
+        if(!out.empty())
+            out += ' ';
+        out += nt.san;
+    }
+    return copy_out(out.c_str(),out.size(),buf,len);
+}
+
+int chess_legal_moves_uci(chess_position* pos, char* buf, size_t len) {
+    string out;
+    char uci[UCI_MAX];
+    for(const note& nt: pos->game.notes()) {
+        if(!out.empty())
+            out += ' ';
+        pos->game.to_uci(nt.mv,uci);
+        out += uci;
+    }
+    return copy_out(out.c_str(),out.size(),buf,len);
+}
+
+int chess_get_state(chess_position* pos) {
+    return pos->game.get_state();
+}
+
+int chess_side_to_move(chess_position* pos) {
+    return pos->game.active==WT ? 1 : 0;
+}
+
+int chess_get_fen(chess_position* pos, char* buf, size_t len) {
+    string fen = pos->game.get_FEN();
+    return copy_out(fen.c_str(),fen.size(),buf,len);
+}
+
+}
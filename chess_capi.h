@@ -0,0 +1,48 @@
+#ifndef CHESS_CAPI_H
+#define CHESS_CAPI_H
+#include <stdint.h>
+#include <stddef.h>
+
+/* C interface of libchess.so, for ctypes/cffi and other languages.
+ * Functions returning int return -1 on invalid input. Functions that fill a caller
+ * buffer return the length they need (like snprintf), so a short buffer can be retried. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* same values as NORMAL, CHECK, CHECKMATE, DRAW in chess_state.h */
+#define CHESS_NORMAL 0
+#define CHESS_CHECK 1
+#define CHESS_CHECKMATE 2
+#define CHESS_DRAW 3
+
+typedef struct chess_position chess_position;
+
+chess_position* chess_new(void); /* starting position */
+void chess_free(chess_position* pos);
+int chess_load_fen(chess_position* pos, const char* fen); /* 0, or -1 and pos unchanged */
+
+/* apply moves in order until one is illegal, return how many were applied */
+int chess_apply_san(chess_position* pos, const char* const* moves, int n);
+int chess_apply_uci(chess_position* pos, const char* const* moves, int n);
+/* same, with the moves separated by spaces in one string ("e4 e5 Nf3") */
+int chess_apply_san_line(chess_position* pos, const char* moves);
+int chess_apply_uci_line(chess_position* pos, const char* moves);
+
+/* legal moves packed as from | to<<6 | promotion<<12 (0 none, 1 N, 2 B, 3 R, 4 Q), squares a8=0..h1=63,
+ * writes at most cap moves and returns the number of legal moves */
+int chess_legal_moves(chess_position* pos, uint16_t* moves, int cap);
+/* legal moves separated by spaces */
+int chess_legal_moves_san(chess_position* pos, char* buf, size_t len);
+int chess_legal_moves_uci(chess_position* pos, char* buf, size_t len);
+
+int chess_get_state(chess_position* pos); /* CHESS_NORMAL, CHESS_CHECK, CHESS_CHECKMATE, CHESS_DRAW */
+int chess_side_to_move(chess_position* pos); /* 1 white, 0 black */
+int chess_get_fen(chess_position* pos, char* buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
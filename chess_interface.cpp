@@ -1,169 +1,320 @@
 #include "chess_interface.h"
-#include <sstream>
+#include "chess_stats.h"
+#include <cstring>
+#include <algorithm>
 
-ChessInterface::ChessInterface() {
-    not2move = {};
-    copy1 = *this;
-    copy2 = *this;
-    generate_notes();
+template<class Board>
+BasicChessInterface<Board>::BasicChessInterface() {
+    not2move.reserve(MAX_MOVES);
+    mlist.reserve(MAX_MOVES);
+    set_state(*this);
 }
-void ChessInterface::move(minfo mv) {
-    execute_move(mv);
+template<class Board>
+void BasicChessInterface<Board>::set_state(const BasicChessState<Board>& state) {
+    // reuses the note and move lists, so resetting between games does not allocate
+    BasicChessState<Board>::operator=(state);
+    copy1 = state;
+    copy2 = state;
+    notes_valid = false;
+}
+template<class Board>
+void BasicChessInterface<Board>::move(minfo mv) {
+    this->execute_move(mv);
     copy1.execute_move(mv);
     copy2.execute_move(mv);
-    generate_notes();
+    notes_valid = false; // generated when they are needed
 }
-void ChessInterface::play_moves(vector<string> moves, bool verbose) {
+template<class Board>
+void BasicChessInterface<Board>::play_moves(vector<string> moves, bool verbose) {
     for(string str: moves) {
-        if ((active==WT)&&verbose)
-            cout << fmove << endl;
-        if(not2move.count(str)==0)
+        if ((this->active==WT)&&verbose)
+            cout << this->fmove << endl;
+        const minfo* mv = find_note(str.c_str());
+        if(mv==NULL)
             throw invalid_argument(str+" not in the move list");
         cout << "playing " << str << endl;
-        move(not2move[str]);
+        move(*mv);
         if(verbose) {
-            print_board();
+            this->print_board();
             cout << endl;
         }
     }
 }
 
-bool ChessInterface::one_play_input(int8_t verbose) {
+template<class Board>
+bool BasicChessInterface<Board>::one_play_input(int8_t verbose) {
     // verbose=0: no feedback
     // verbose=1: display board after each move
     // verbose=2: display possible moves for player
-    if ((active==WT)&&verbose)
-        cout << fmove << endl;
+    if ((this->active==WT)&&verbose)
+        cout << this->fmove << endl;
     if(verbose) {
-        print_board();
+        this->print_board();
         cout << endl;
     }
 
     if(verbose==2) {
+        vector<string> notes;
+        for(const note& nt: this->notes())
+            notes.push_back(nt.san);
+        sort(notes.begin(),notes.end());
         cout << "All moves: [";
-        for(auto it = not2move.begin(); it!=not2move.end(); it++) {
-            cout << (it==not2move.begin() ? "":",") << it->first;
+        for(auto it = notes.begin(); it!=notes.end(); it++) {
+            cout << (it==notes.begin() ? "":",") << *it;
         }
         cout << "]" << endl;
     }
     string anot;
     cout << "Move: ";
-    cin >> anot;
+    {
+        STATS_SCOPE(PH_INPUT);
+        cin >> anot;
+    }
     cout << endl;
     
     if(anot=="q")
         return false;
-    if(not2move.count(anot)) {
-        move(not2move[anot]);
+    if(play_san(anot.c_str()))
         cout << "playing " << anot << endl;
-    }
     else
         throw invalid_argument(anot+" is not in the move dict.");
     return true;
 }
-void ChessInterface::play_input(int8_t verbose) {
+template<class Board>
+bool BasicChessInterface<Board>::play_san(const char* san) {
+    const minfo* mv = find_note(san);
+    if(mv==NULL)
+        return false;
+    move(*mv); // copies the move before the notes are regenerated
+    return true;
+}
+template<class Board>
+bool BasicChessInterface<Board>::play_uci(const char* uci) {
+    char nt[UCI_MAX];
+    mlist.clear();
+    this->all_legal_moves(mlist,&copy1);
+    for(minfo mv: mlist) {
+        to_uci(mv,nt);
+        if(strcmp(nt,uci)==0) {
+            move(mv);
+            return true;
+        }
+    }
+    return false;
+}
+template<class Board>
+bool BasicChessInterface<Board>::parse_san(const char* san, minfo& mv) {
+    // resolves SAN against the legal moves without rendering every move's SAN,
+    // check/mate markers and !? annotations are ignored
+    size_t len = strcspn(san,"+#!?");
+    uint8_t castle = NCAST;
+    char type = 'P';
+    char promo = 0;
+    int8_t fcol = -1; // disambiguation, -1 if not given
+    int8_t frow = -1;
+    uint8_t sq2 = 0;
+    if(len==5&&(strncmp(san,"O-O-O",5)==0||strncmp(san,"0-0-0",5)==0))
+        castle = QCAST;
+    else if(len==3&&(strncmp(san,"O-O",3)==0||strncmp(san,"0-0",3)==0))
+        castle = KCAST;
+    else {
+        const char* ch = san;
+        const char* end = san+len;
+        if(ch<end&&strchr("NBRQK",*ch))
+            type = *(ch++);
+        // promotion: e8=Q or e8Q
+        if(type=='P'&&end-ch>=3&&strchr("NBRQ",end[-1])) {
+            promo = *(--end);
+            if(end[-1]=='=')
+                end--;
+        }
+        if(end-ch<2||end[-2]<'a'||end[-2]>='a'+SZ||end[-1]<'1'||end[-1]>='1'+SZ)
+            return false;
+        sq2 = (SZ-(end[-1]-'0'))*SZ+(end[-2]-'a');
+        for(end-=2; ch<end; ch++) {
+            if(*ch>='a'&&*ch<'a'+SZ)
+                fcol = *ch-'a';
+            else if(*ch>='1'&&*ch<'1'+SZ)
+                frow = SZ-(*ch-'0');
+            else if(*ch!='x')
+                return false;
+        }
+    }
+
+    mlist.clear();
+    this->all_legal_moves(mlist,&copy1);
+    bool found = false;
+    for(minfo cand: mlist) {
+        if(castle!=NCAST) {
+            if(cand.castle!=castle)
+                continue;
+        } else {
+            uint8_t piece = this->get(cand.sq1);
+            if(cand.castle!=NCAST||cand.sq2!=sq2||this->map_type(piece)!=type)
+                continue;
+            if((fcol>=0&&cand.sq1%SZ!=fcol)||(frow>=0&&cand.sq1/SZ!=frow))
+                continue;
+            if(promo ? (this->map_type(cand.newp)!=promo) : (cand.newp!=piece))
+                continue;
+        }
+        if(found) // ambiguous
+            return false;
+        mv = cand;
+        found = true;
+    }
+    return found;
+}
+template<class Board>
+const vector<note>& BasicChessInterface<Board>::notes() {
+    if(!notes_valid)
+        generate_notes();
+    return not2move;
+}
+template<class Board>
+const minfo* BasicChessInterface<Board>::find_note(const char* san) {
+    for(const note& nt: notes()) {
+        if(strcmp(nt.san,san)==0)
+            return &nt.mv;
+    }
+    return NULL;
+}
+template<class Board>
+void BasicChessInterface<Board>::play_input(int8_t verbose) {
     // verbose=0: no feedback
     // verbose=1: display board after each move
     // verbose=2: display possible moves for player
     while(one_play_input(verbose)) {}
 }
 
-void ChessInterface::generate_notes() {
+template<class Board>
+void BasicChessInterface<Board>::generate_notes() {
+    STATS_SCOPE(PH_GENERATE_NOTES);
     not2move.clear();
-    vector<minfo> mlist;
-    all_legal_moves(mlist,&copy1);
-    // p2minfo for disambiguation: if multiple white knights are going to sq2, then map[WN<<8+sq2] contains both their starting squares.
-    map<uint16_t,vector<uint8_t>> p2minfo;
-    for(minfo minf: mlist) { // for disambiguation
-        uint8_t psq1 = board[minf.sq1/SZ][minf.sq1%SZ];
-        p2minfo[(psq1<<8) + minf.sq2].push_back(minf.sq1);
-    }
-    stringstream note;
+    mlist.clear();
+    this->all_legal_moves(mlist,&copy1);
+    note nt;
     for(minfo minf: mlist) {
-        note.str("");
+        to_san(minf,nt.san);
+        nt.mv = minf;
+        not2move.push_back(nt);
+    }
+    notes_valid = true;
+}
 
-        uint8_t r1 = minf.sq1/SZ;
-        uint8_t c1 = minf.sq1%SZ;
-        uint8_t r2 = minf.sq2/SZ;
-        uint8_t c2 = minf.sq2%SZ;
-        uint8_t psq1 = board[r1][c1];
-        uint8_t psq2 = board[r2][c2];
+template<class Board>
+uint8_t BasicChessInterface<Board>::to_san(minfo minf, char* san) {
+    STATS_SCOPE(PH_TO_SAN);
+    uint8_t len = 0;
 
-        // castling
-        if((minf.castle)==KCAST)
-            note << "O-O";
-        else if((minf.castle)==QCAST)
-            note << "O-O-O";
-        // pawn moves
-        else if((psq1==WP)||(psq1==BP)) {
-            if(c1==c2) {
-                // pawn moves forward, does not promote (d6,e4)
-                if(psq1==minf.newp)
-                    note << cols[c2] << int(SZ-r2);
-                // pawn moves forward, promotes (e8=Q)
-                else
-                    note << cols[c2] << int(SZ-r2) << "=" << map_type(minf.newp);
-            } else {
-                // pawn captures (exd5), en passant included
-                if(psq1==minf.newp)
-                    note << cols[c1] << "x" << cols[c2] << int(SZ-r2);
-                // pawn moves forward, promotes (e8=Q)
-                else {
-                    note << cols[c1] << "x" << cols[c2] << int(SZ-r2) << "=" << map_type(minf.newp);
-                }
-            }
-        } 
-        // any other piece (NBRQK)
-        else {
-            // piece name
-            note << map_type(psq1);
-            const auto& other_sqs = p2minfo[(psq1<<8)+minf.sq2];
-            // disambiguation
-            if(other_sqs.size()>1) {
-                bool cols_differ = true;
-                bool rows_differ = true;
-                for(uint8_t sq3: other_sqs) {
-                    if(sq3==minf.sq1)
-                        continue;
-                    else if(sq3%SZ==c1)
-                        cols_differ = false;
-                    else if(sq3/SZ==r1)
-                        rows_differ = false;
-                }
-                if(cols_differ)
-                    note << cols[c1];
-                else if(rows_differ)
-                    note << int(SZ-r1);
-                else
-                    note << cols[c1] << int(SZ-r1);
+    uint8_t r1 = minf.sq1/SZ;
+    uint8_t c1 = minf.sq1%SZ;
+    uint8_t r2 = minf.sq2/SZ;
+    uint8_t c2 = minf.sq2%SZ;
+    uint8_t psq1 = this->get(minf.sq1);
+    uint8_t psq2 = this->get(minf.sq2);
+
+    // castling
+    if((minf.castle)==KCAST) {
+        memcpy(san,"O-O",3);
+        len = 3;
+    }
+    else if((minf.castle)==QCAST) {
+        memcpy(san,"O-O-O",5);
+        len = 5;
+    }
+    // pawn moves
+    else if((psq1==WP)||(psq1==BP)) {
+        // pawn captures (exd5), en passant included
+        if(c1!=c2) {
+            san[len++] = this->cols[c1];
+            san[len++] = 'x';
+        }
+        // pawn moves forward (d6,e4)
+        san[len++] = this->cols[c2];
+        san[len++] = '0'+SZ-r2;
+        // pawn promotes (e8=Q)
+        if(psq1!=minf.newp) {
+            san[len++] = '=';
+            san[len++] = this->map_type(minf.newp);
+        }
+    } 
+    // any other piece (NBRQK)
+    else {
+        // piece name
+        san[len++] = this->map_type(psq1);
+        // disambiguation: only same-type pieces that can also legally reach sq2
+        bool ambiguous = false;
+        bool cols_differ = true;
+        bool rows_differ = true;
+        for(uint8_t sq3: this->squares(psq1)) {
+            if(sq3==minf.sq1 || !this->is_checking(sq3,minf.sq2))
+                continue;
+            minfo other = {sq3,minf.sq2,psq1,NCAST};
+            if(!this->is_legal(other,&copy1)) // pinned pieces do not need to be disambiguated
+                continue;
+            ambiguous = true;
+            if(sq3%SZ==c1)
+                cols_differ = false;
+            else if(sq3/SZ==r1)
+                rows_differ = false;
+        }
+        if(ambiguous) {
+            if(cols_differ)
+                san[len++] = this->cols[c1];
+            else if(rows_differ)
+                san[len++] = '0'+SZ-r1;
+            else {
+                san[len++] = this->cols[c1];
+                san[len++] = '0'+SZ-r1;
             }
-            // capture
-            if(psq2!=EMP)
-                note << "x";
-            // square: e.g. f3
-            note << cols[c2] << int(SZ-r2);
         }
-        // markers: +(check) or #(checkmate)
-        // e.g. white moves, did they check/checkmate black?
-        copy1.execute_move(minf); // white -> black
-        uint8_t ksq = *copy1.psquares[(active==WT)?BK:WK].begin();
-        // check: could white capture black king if they moved again?
-        if(copy1.is_checking(active,ksq)) { 
-            // does black have legal moves
-            vector<minfo> mlist2 = {};
+        // capture
+        if(psq2!=EMP)
+            san[len++] = 'x';
+        // square: e.g. f3
+        san[len++] = this->cols[c2];
+        san[len++] = '0'+SZ-r2;
+    }
+    // markers: +(check) or #(checkmate)
+    // e.g. white moves, did they check/checkmate black?
+    copy1.execute_move(minf); // white -> black
+    uint8_t ksq = *copy1.squares((this->active==WT)?BK:WK).begin();
+    // check: could white capture black king if they moved again?
+    if(copy1.is_checking(this->active,ksq)) { 
+        // checkmate occurs if black has no legal moves
+        copy2.execute_move(minf);
+        san[len++] = copy1.has_legal_move(&copy2) ? '+' : '#';
+        copy2.undo_move(*this,minf);
+    }
+    copy1.undo_move(*this,minf);
 
-            copy2.execute_move(minf);
-            copy1.all_legal_moves(mlist2,&copy2);
-            copy2.undo_move(*this,minf);
+    san[len] = 0;
+    return len;
+}
 
-            // checkmate occurs if 
-            if(mlist2.size()==0)
-                note << "#";
-            else
-                note << "+";
-        }
-        copy1.undo_move(*this,minf);
+template<class Board>
+string BasicChessInterface<Board>::to_san(minfo mv) {
+    char san[SAN_MAX];
+    uint8_t len = to_san(mv,san);
+    return string(san,len);
+}
 
-        not2move[note.str()] = minf;
+template<class Board>
+uint8_t BasicChessInterface<Board>::to_uci(minfo mv, char* uci) {
+    uint8_t len = 0;
+    uci[len++] = this->cols[mv.sq1%SZ];
+    uci[len++] = '0'+SZ-mv.sq1/SZ;
+    uci[len++] = this->cols[mv.sq2%SZ];
+    uci[len++] = '0'+SZ-mv.sq2/SZ;
+    // promotion: a pawn becomes another piece (e7e8q)
+    if(this->get(mv.sq1)!=mv.newp) {
+        uci[len++] = this->map_type(mv.newp)-'A'+'a';
     }
-}
\ No newline at end of file
+    uci[len] = 0;
+    return len;
+}
+
+template class BasicChessInterface<BitboardBoard>;
+template class BasicChessInterface<MailboxBoard>;
+template class BasicChessInterface<PieceListBoard>;
+template class BasicChessInterface<X88Board>;
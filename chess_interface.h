@@ -1,14 +1,41 @@
+#ifndef CHESS_INTERFACE_H
+#define CHESS_INTERFACE_H
 #include "chess_state.h"
-class ChessInterface: public ChessState { // handles algebraic notation, can play from move list, handle human input
+
+#define SAN_MAX 8 // longest SAN is 7 characters (e.g. Qa1xb2#), plus the null terminator
+#define UCI_MAX 6 // e7e8q, plus the null terminator
+
+struct note { // a legal move and its SAN
+    char san[SAN_MAX];
+    minfo mv;
+};
+
+template<class Board>
+class BasicChessInterface: public BasicChessState<Board> { // handles algebraic notation, can play from move list, handle human input
     public:
-        ChessInterface();
+        BasicChessInterface();
+        void set_state(const BasicChessState<Board>& state); // start from another position, e.g. a new game
         void move(minfo mv);
+        bool play_san(const char* san); // plays a legal move given in SAN, returns false if it is not legal
+        bool play_uci(const char* uci); // same for long algebraic notation (e2e4, e7e8q, e1g1)
+        bool parse_san(const char* san, minfo& mv); // finds the legal move of a SAN, faster than generating every note
+        const vector<note>& notes(); // the legal moves of the current position
         void play_moves(vector<string> moves, bool verbose=true);
         bool one_play_input(int8_t verbose=2); // make the next move according to human input, return false if human quit
         void play_input(int8_t verbose=2); // keep moving according to input until "q"
+        uint8_t to_san(minfo mv, char* san); // writes the SAN of a legal move into san[SAN_MAX], returns its length
+        string to_san(minfo mv);
+        uint8_t to_uci(minfo mv, char* uci); // writes into uci[UCI_MAX], returns its length
     private:
-        ChessState copy1;
-        ChessState copy2;
-        map<string,minfo> not2move; // maps notations to legal moves
+        BasicChessState<Board> copy1;
+        BasicChessState<Board> copy2;
+        vector<note> not2move; // notations of the legal moves, regenerated lazily after every move
+        bool notes_valid;
+        vector<minfo> mlist; // legal moves scratch list
         void generate_notes();
-};
\ No newline at end of file
+        const minfo* find_note(const char* san); // NULL if san is not a legal move
+};
+
+typedef BasicChessInterface<BitboardBoard> ChessInterface;
+
+#endif
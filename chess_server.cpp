@@ -0,0 +1,39 @@
+#include "game_server.h"
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+
+static GameServer* server = NULL;
+static void handle_signal(int) {
+    if(server)
+        server->stop();
+}
+
+int main(int argc, char** argv) {
+    // chess_server [--socket path] [--workers N], see game_server.h for the protocol
+    string path = "/tmp/chess.sock";
+    uint32_t nworkers = thread::hardware_concurrency();
+    for(int i=1; i<argc; i++) {
+        if(strcmp(argv[i],"--socket")==0&&i+1<argc)
+            path = argv[++i];
+        else if(strcmp(argv[i],"--workers")==0&&i+1<argc)
+            nworkers = atoi(argv[++i]);
+        else {
+            cerr << "usage: " << argv[0] << " [--socket path] [--workers N]" << endl;
+            return 1;
+        }
+    }
+    try {
+        GameServer gs(path,nworkers);
+        server = &gs;
+        signal(SIGINT,handle_signal);
+        signal(SIGTERM,handle_signal);
+        cerr << "serving on " << path << endl;
+        gs.run();
+        server = NULL;
+    } catch(const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
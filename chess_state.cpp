@@ -1,59 +1,72 @@
 #include "chess_state.h"
+#include "chess_stats.h"
 #include <sstream>
+#include <cstring>
+
+template<class Board>
+BasicChessState<Board>::BasicChessState(const string& fen) {
+    // fields: board, active player, castling, en passant, half-move clock, full-move clock (clocks are optional)
+    stringstream ss(fen);
+    string fboard, factive, fcast, fenpassant;
+    if(!(ss >> fboard >> factive >> fcast >> fenpassant))
+        throw invalid_argument(fen+" is not a valid FEN");
+    if(!(ss >> hmove))
+        hmove = 0;
+    if(!(ss >> fmove))
+        fmove = 1;
 
-ChessState::ChessState(const string& fen) {
     // board
+    uint8_t parsed[SZ][SZ];
     uint8_t crow = 0;
     uint8_t ccol = 0;
-    auto it = fen.begin();
-    for(;crow<SZ;it++) {
-        if(*it=='/'||*it==' ') {
+    for(char ch: fboard) {
+        if(ch=='/') {
+            if(ccol!=SZ)
+                throw invalid_argument(fen+" is not a valid FEN");
             crow+=1;
             ccol=0;
-        } else if(isdigit(*it)) {
-            for(uint8_t j=0; j<*it-'0';j++)
-                board[crow][ccol++] = EMP;
+        } else if(isdigit(ch)) {
+            for(uint8_t j=0; j<ch-'0'&&crow<SZ&&ccol<SZ;j++)
+                parsed[crow][ccol++] = EMP;
+        } else if(crow<SZ&&ccol<SZ&&char2p.count(ch)&&char2p[ch]!=EMP) {
+            parsed[crow][ccol++] = char2p[ch];
         } else
-            board[crow][ccol++] = char2p[*it];//wrong
+            throw invalid_argument(fen+" is not a valid FEN");
     }
-
-    active = (*(it++)=='w')?WT:BT;
-    it++; // skip over space
-
-    cast = (*(it++)=='K') ? (1<<WKCAST) : 0;
-    if(*(it++)=='Q') cast |= 1<<WQCAST;
-    if(*(it++)=='k') cast |= 1<<BKCAST;
-    if(*(it++)=='q') cast |= 1<<BQCAST;
-    it++; // skip over space
-
-    char ch = *(it++);
-    if(ch=='-')
-        enpassant = SZ*SZ;
-    else
-        enpassant = (SZ-(*(it++)-'0'))*SZ+char2col[ch]; // row and col
-    
-
-    hmove = 0;
-    ch = *(++it);
-    while(ch!=' ') {
-        hmove += 10*hmove+(ch-'0');
-        ch = *(++it);
+    if(crow!=SZ-1||ccol!=SZ)
+        throw invalid_argument(fen+" is not a valid FEN");
+
+    active = (factive=="w")?WT:BT;
+
+    // "KQkq", any subset of it, or "-" (get_FEN used to write "K-k-")
+    cast = 0;
+    for(char ch: fcast) {
+        if(ch=='K') cast |= 1<<WKCAST;
+        else if(ch=='Q') cast |= 1<<WQCAST;
+        else if(ch=='k') cast |= 1<<BKCAST;
+        else if(ch=='q') cast |= 1<<BQCAST;
     }
-    
-    // ch == ' ', it points to ch
-    it++;
-    fmove = 0;
-    while(it!=fen.end())
-        fmove += 10*fmove+(*(it++)-'0');
 
+    if(fenpassant.size()==2&&char2col.count(fenpassant[0])&&fenpassant[1]>='1'&&fenpassant[1]<='0'+SZ)
+        enpassant = (SZ-(fenpassant[1]-'0'))*SZ+char2col[fenpassant[0]]; // row and col
+    else
+        enpassant = SZ*SZ;
 
-    // psquares
-    for(int i=0; i<INV; i++) {
-        psquares[i] = set<uint8_t>();
+    // pieces, piece lists hold at most PLIST_MAX of a kind
+    this->clear();
+    for(uint8_t sq=0; sq<SZ*SZ; sq++) {
+        uint8_t piece = parsed[sq/SZ][sq%SZ];
+        if(piece==EMP)
+            continue;
+        if(this->count(piece)==PLIST_MAX)
+            throw invalid_argument(fen+" has more than "+to_string(PLIST_MAX)+" of a piece");
+        this->put(sq,piece);
     }
-    fill_psquares();
+    if(this->count(WK)!=1||this->count(BK)!=1)
+        throw invalid_argument(fen+" must have one king per side");
 }
-string ChessState::get_FEN() {
+template<class Board>
+string BasicChessState<Board>::get_FEN() {
     stringstream ss;
     uint8_t cnt; // number of empty squares consecutively in a row
     uint8_t psq;
@@ -62,7 +75,7 @@ string ChessState::get_FEN() {
     for(uint8_t i=0; i<SZ; i++) {
         cnt = 0;
         for(uint8_t j=0;j<SZ;j++) {
-            psq = board[i][j];
+            psq = this->get(i*SZ+j);
             if(psq==EMP)
                 cnt+=1;
             else {
@@ -81,10 +94,11 @@ string ChessState::get_FEN() {
     // w/b turn
     ss << ((active==WT)?'w':'b') << ' ';
     // castling availability
-    ss << (((cast>>WKCAST)%2==1)?'K':'-')
-        << (((cast>>WQCAST)%2==1)?'Q':'-')
-        << (((cast>>BKCAST)%2==1)?'k':'-')
-        << (((cast>>BQCAST)%2==1)?'q':'-');
+    if((cast>>WKCAST)%2==1) ss << 'K';
+    if((cast>>WQCAST)%2==1) ss << 'Q';
+    if((cast>>BKCAST)%2==1) ss << 'k';
+    if((cast>>BQCAST)%2==1) ss << 'q';
+    if(cast==0) ss << '-';
     ss << ' ';
     // enpassant
     if(enpassant<SZ*SZ)
@@ -94,7 +108,8 @@ string ChessState::get_FEN() {
     ss << ' ' << hmove << ' ' << fmove;
     return ss.str();
 }
-ChessState::ChessState() {
+template<class Board>
+BasicChessState<Board>::BasicChessState() {
     uint8_t dboard[8][8] = {
                     {BR,BN,BB,BQ,BK,BB,BN,BR},
                     {BP,BP,BP,BP,BP,BP,BP,BP},
@@ -104,20 +119,20 @@ ChessState::ChessState() {
                     {EMP,EMP,EMP,EMP,EMP,EMP,EMP,EMP},
                     {WP,WP,WP,WP,WP,WP,WP,WP},
                     {WR,WN,WB,WQ,WK,WB,WN,WR}};
-    memcpy(board,dboard,SZ*SZ*sizeof(uint8_t));
+    this->clear();
+    for(uint8_t sq=0; sq<SZ*SZ; sq++) {
+        if(dboard[sq/SZ][sq%SZ]!=EMP)
+            this->put(sq,dboard[sq/SZ][sq%SZ]);
+    }
     active = WT;
     cast = (1<<WKCAST) | (1<<WQCAST) | (1<<BKCAST) | (1<<BQCAST);
     enpassant = SZ*SZ;
     hmove = 0;
     fmove = 1;
-
-    for(int i=0; i<INV; i++) {
-        psquares[i] = set<uint8_t>();
-    }
-    fill_psquares();
 }
 
-void ChessState::print_board() {
+template<class Board>
+void BasicChessState<Board>::print_board() {
     for(uint8_t j=0;j<2*SZ+1;j++) {
         cout << '-';
     }
@@ -125,7 +140,7 @@ void ChessState::print_board() {
     for(uint8_t i=0;i<SZ;i++) {
         cout << '|';
         for(uint8_t j=0;j<SZ;j++) {
-            cout << pchars[board[i][j]] << '|';
+            cout << pchars[this->get(i*SZ+j)] << '|';
         }
         cout << endl;
         for(uint8_t j=0;j<2*SZ+1;j++) {
@@ -135,7 +150,7 @@ void ChessState::print_board() {
     }
 }
 
-uint8_t ChessState::map_piece(bool active,char type) { // ex: WT,'Q' -> WQ
+uint8_t ChessTables::map_piece(bool active,char type) { // ex: WT,'Q' -> WQ
     if(active==WT) {
         switch(type) {
             case 'P':
@@ -170,7 +185,7 @@ uint8_t ChessState::map_piece(bool active,char type) { // ex: WT,'Q' -> WQ
     }
     return EMP;
 }
-char ChessState::map_type(uint8_t piece) {
+char ChessTables::map_type(uint8_t piece) {
     switch(piece) {
         case WP:
         case BP:
@@ -194,16 +209,17 @@ char ChessState::map_type(uint8_t piece) {
             return 0; // ERROR
     }
 }
-void ChessState::pawn_moves(uint8_t sq, vector<minfo>& move_list) {
+template<class Board>
+void BasicChessState<Board>::pawn_moves(uint8_t sq, vector<minfo>& move_list) {
     uint8_t r = sq/SZ;
     uint8_t c = sq%SZ;
     minfo minfo;
     minfo.sq1 = sq;
-    minfo.newp = board[r][c];
+    minfo.newp = this->get(sq);
     minfo.castle = NCAST;
 
     int8_t fdir = (active==WT)? -1: 1; // row direction of forward movement for pawn
-    if(board[r+fdir][c]==EMP) { // can move forward
+    if(this->at(r+fdir,c)==EMP) { // can move forward
         minfo.sq2 = sq+fdir*SZ;
         if(((r+fdir)==0)||((r+fdir)==SZ-1)) { // must promote on last row
             for(char ch: promotions) {
@@ -213,15 +229,17 @@ void ChessState::pawn_moves(uint8_t sq, vector<minfo>& move_list) {
         } else {
             move_list.push_back(minfo); // move forward 1 square
             // move two squares if pawn is on its first row and the two squares are empty
-            if((((r-fdir)==0)||((r-fdir)==SZ-1))&&(board[r+2*fdir][c]==EMP)) {
+            if((((r-fdir)==0)||((r-fdir)==SZ-1))&&(this->at(r+2*fdir,c)==EMP)) {
                 minfo.sq2 = sq+2*fdir*SZ;
                 move_list.push_back(minfo);
             }
         }
     }
     for(int8_t cdir=1;cdir>=-1;cdir-=2) { // capture left or right
+        if((c+cdir<0)||(c+cdir>=SZ)) // h-pawn capturing right would wrap around (and could match enpassant==SZ*SZ)
+            continue;
         minfo.sq2 = sq+fdir*SZ+cdir;
-        uint8_t oldp = ELEM(board,r+fdir,c+cdir);
+        uint8_t oldp = this->at(r+fdir,c+cdir);
         // en passant
         if(minfo.sq2==enpassant) {
             move_list.push_back(minfo);
@@ -240,105 +258,69 @@ void ChessState::pawn_moves(uint8_t sq, vector<minfo>& move_list) {
 
     }
 }
-void ChessState::limited_piece_moves(uint8_t sq, vector<minfo>& move_list, const vector<pair<int8_t,int8_t> >& dirs) {
-    uint8_t r = sq/SZ;
-    uint8_t c = sq%SZ;
-    uint8_t r2;
-    uint8_t c2;
-    uint8_t pdest;
+template<class Board>
+void BasicChessState<Board>::piece_moves(uint8_t sq, vector<minfo>& move_list) {
     minfo minfo;
     minfo.sq1 = sq;
-    minfo.newp = board[r][c];
-    minfo.castle=NCAST;
-    for(auto dpair: dirs) {
-        r2 = r+dpair.first;
-        c2 = c+dpair.second;
-        pdest = ELEM(board,r2,c2);
-        // invalid move iff out-of-bounds or captures your own piece
-        if((pdest==INV)||((active==WT)&&IS_WHITE(pdest))||((active==BT)&&IS_BLACK(pdest)))
-            continue;
-        
-        minfo.sq2=r2*SZ+c2;
-        move_list.push_back(minfo);  
-    }
-}
-void ChessState::unlimited_piece_moves(uint8_t sq, vector<minfo>& move_list, const vector<pair<int8_t,int8_t> >& dirs) {
-    uint8_t r = sq/SZ;
-    uint8_t c = sq%SZ;
-    uint8_t r2;
-    uint8_t c2;
-    uint8_t pdest;
-
-    minfo minfo;
-    minfo.sq1 = sq;
-    minfo.newp=board[r][c];
-    minfo.castle=NCAST;
-
-    for(auto dpair: dirs) {
-        r2 = r+dpair.first; // first square on direction
-        c2 = c+dpair.second;
-        pdest = ELEM(board,r2,c2);
-        while(pdest==EMP) {
-            minfo.sq2 = r2*SZ+c2;
-            move_list.push_back(minfo);
-            r2+=dpair.first; // continue on direction
-            c2+=dpair.second;
-            pdest = ELEM(board,r2,c2);
-        }
-        if (((active==WT)&&IS_BLACK(pdest))||((active==BT)&&IS_WHITE(pdest))) {
-            minfo.sq2 = r2*SZ+c2;
-            move_list.push_back(minfo);
-        }
+    minfo.newp = this->get(sq);
+    minfo.castle = NCAST;
+    for(uint64_t targets=this->targets(sq); targets; targets&=targets-1) { // from the board policy
+        minfo.sq2 = __builtin_ctzll(targets);
+        move_list.push_back(minfo);
     }
 }
-void ChessState::knight_moves(uint8_t sq,vector<minfo>& move_list) {
-    limited_piece_moves(sq,move_list,knight_dirs);
+template<class Board>
+void BasicChessState<Board>::knight_moves(uint8_t sq,vector<minfo>& move_list) {
+    piece_moves(sq,move_list);
 }
-void ChessState::qcast_moves(uint8_t sq, vector<minfo>& move_list) {
+template<class Board>
+void BasicChessState<Board>::qcast_moves(uint8_t sq, vector<minfo>& move_list) {
     // does not check if castling puts king through/in check
     if(!(((active==WT)&&((cast>>WQCAST)%2))||((active==BT)&&((cast>>BQCAST)%2))))
         return;
-    uint8_t r = sq/SZ;
-    uint8_t c = sq%SZ;
     minfo minfo;
     minfo.sq1 = sq;
     minfo.sq2 = sq-2;
-    minfo.newp = board[r][c];
+    minfo.newp = this->get(sq);
     minfo.castle=QCAST;
 
-    if((board[r][c-1]==EMP)&&(board[r][c-2]==EMP)&&(board[r][c-3]==EMP))
+    if((this->get(sq-1)==EMP)&&(this->get(sq-2)==EMP)&&(this->get(sq-3)==EMP))
         move_list.push_back(minfo);
 }
-void ChessState::kcast_moves(uint8_t sq, vector<minfo>& move_list) {
+template<class Board>
+void BasicChessState<Board>::kcast_moves(uint8_t sq, vector<minfo>& move_list) {
     // does not check if castling puts king through/in check
     if(!(((active==WT)&&((cast>>WKCAST)%2))||((active==BT)&&((cast>>BKCAST)%2))))
         return;
-    uint8_t r = sq/SZ;
-    uint8_t c = sq%SZ;
     minfo minfo;
     minfo.sq1 = sq;
     minfo.sq2 = sq+2;
-    minfo.newp = board[r][c];
+    minfo.newp = this->get(sq);
     minfo.castle=KCAST;
 
-    if((board[r][c+1]==EMP)&&(board[r][c+2]==EMP))
+    if((this->get(sq+1)==EMP)&&(this->get(sq+2)==EMP))
         move_list.push_back(minfo);
 }
-void ChessState::king_moves(uint8_t sq,vector<minfo>& move_list) {
-    limited_piece_moves(sq,move_list,king_dirs);
+template<class Board>
+void BasicChessState<Board>::king_moves(uint8_t sq,vector<minfo>& move_list) {
+    piece_moves(sq,move_list);
     qcast_moves(sq,move_list);
     kcast_moves(sq,move_list);
 }
-void ChessState::bishop_moves(uint8_t sq,vector<minfo>& move_list) {
-    unlimited_piece_moves(sq,move_list,bishop_dirs);
+template<class Board>
+void BasicChessState<Board>::bishop_moves(uint8_t sq,vector<minfo>& move_list) {
+    piece_moves(sq,move_list);
 }
-void ChessState::rook_moves(uint8_t sq,vector<minfo>& move_list) {
-    unlimited_piece_moves(sq,move_list,rook_dirs);
+template<class Board>
+void BasicChessState<Board>::rook_moves(uint8_t sq,vector<minfo>& move_list) {
+    piece_moves(sq,move_list);
 }
-void ChessState::queen_moves(uint8_t sq,vector<minfo>& move_list) {
-    unlimited_piece_moves(sq,move_list,queen_dirs);
+template<class Board>
+void BasicChessState<Board>::queen_moves(uint8_t sq,vector<minfo>& move_list) {
+    piece_moves(sq,move_list);
 }
-void ChessState::all_moves(uint8_t sq, uint8_t piece, vector<minfo>& move_list) {
+template<class Board>
+void BasicChessState<Board>::all_moves(uint8_t sq, uint8_t piece, vector<minfo>& move_list) {
     // does not check if a move puts king in check
     char type = map_type(piece);
     switch(type) {
@@ -357,30 +339,22 @@ void ChessState::all_moves(uint8_t sq, uint8_t piece, vector<minfo>& move_list)
     }
 }
 
-void ChessState::all_moves(vector<minfo>& move_list) {
+template<class Board>
+void BasicChessState<Board>::all_moves(vector<minfo>& move_list) {
+    STATS_SCOPE(PH_ALL_MOVES);
     // does not check if a move puts king in check or whether castle puts king through check
     // fills in move_list with all possible moves
     uint8_t pstart = (active==WT) ? (EMP+1) : (WK+1);
     uint8_t pend = pstart+WK; // not-inclusive
     for(uint8_t p=pstart;p<pend;p++) {
-        for(uint8_t sq: psquares[p]) {
-            all_moves(sq,board[sq/SZ][sq%SZ],move_list);
+        for(uint8_t sq: this->squares(p)) {
+            all_moves(sq,p,move_list);
         }
     }
 }
 
-void ChessState::fill_psquares() {
-    // fill in psquares
-    for(int r=0;r<SZ;r++) {
-        for(int c=0; c<SZ; c++) {
-            if(board[r][c]!=EMP) {
-                psquares[board[r][c]].insert(r*SZ+c);
-            }
-        }
-    }
-}
-
-void ChessState::execute_move(minfo minfo) {
+template<class Board>
+void BasicChessState<Board>::execute_move(minfo minfo) {
     // move piece from square 1 to square 2 (must accomodate en passant and castle)
     // the piece becomes newp on square 2 (e.g. promotion)
     // does not check if move is legal
@@ -389,8 +363,8 @@ void ChessState::execute_move(minfo minfo) {
     uint8_t newp = minfo.newp;
     uint8_t castle = minfo.castle;
 
-    uint8_t& psq1 = board[sq1/SZ][sq1%SZ];
-    uint8_t& psq2 = board[sq2/SZ][sq2%SZ];
+    uint8_t psq1 = this->get(sq1);
+    uint8_t psq2 = this->get(sq2);
     // reset hmove clock if capture or pawn move
     uint8_t next_enpassant = SZ*SZ; // enpassant available on next move?
     if (psq1==WP || psq1==BP) { // pawn move
@@ -413,41 +387,34 @@ void ChessState::execute_move(minfo minfo) {
     if ((cast>>BKCAST)%2 && ((sq1==BKSQ)||(sq1==BKSQ+SZ-5)||(sq2==BKSQ+SZ-5)))
         cast -= (1<<BKCAST);
 
-    // update board and psquares
-    psquares[psq1].erase(sq1); // piece moves away from sq1
-    psquares[psq2].erase(sq2); // piece at sq2 delete
-    psquares[newp].insert(sq2); // new piece at sq2
+    // update board
+    this->remove(sq1); // piece moves away from sq1
+    if (psq2!=EMP)
+        this->remove(sq2); // piece at sq2 delete
+    this->put(sq2,newp); // new piece at sq2
 
-    psq1 = EMP; // updates board using reference
-    psq2 = newp;
-    
     // enpassant
     if ((newp==WP||newp==BP)&&sq2==enpassant) {
         // pawn captured  by enpassant has the same row as sq1 and same column as sq2
         uint8_t sq3 = sq1/SZ*SZ+sq2%SZ;
-        uint8_t& psq3 = board[sq3/SZ][sq3%SZ];
-        psquares[psq3].erase(sq3); // update psquares
-        psq3 = EMP; // update board
+        if (this->get(sq3)!=EMP)
+            this->remove(sq3);
     } // castling
     else if (castle==QCAST){
         uint8_t sq4 = sq1-sq1%SZ; // left-most square is queenside rook
-        uint8_t& psq4 = board[sq4/SZ][0];
-        uint8_t& psq5 = board[sq4/SZ][3];
-        psquares[psq4].erase(sq4);
-        psquares[psq4].insert(sq4+3);
-
-        psq5 = psq4;
-        psq4 = EMP;
+        uint8_t rook = this->get(sq4);
+        if (rook!=EMP) {
+            this->remove(sq4);
+            this->put(sq4+3,rook);
+        }
     }
     else if (castle==KCAST) {
-        uint8_t sq4 = sq1-sq1%SZ+SZ-1; // right-most square is queenside rook
-        uint8_t& psq4 = board[sq4/SZ][SZ-1];
-        uint8_t& psq5 = board[sq4/SZ][SZ-3];
-        psquares[psq4].erase(sq4);
-        psquares[psq4].insert(sq4-2);
-
-        psq5 = psq4;
-        psq4 = EMP;
+        uint8_t sq4 = sq1-sq1%SZ+SZ-1; // right-most square is kingside rook
+        uint8_t rook = this->get(sq4);
+        if (rook!=EMP) {
+            this->remove(sq4);
+            this->put(sq4-2,rook);
+        }
     }
 
     // update next player and enpassant
@@ -455,7 +422,8 @@ void ChessState::execute_move(minfo minfo) {
     enpassant = next_enpassant;
 }
 
-void ChessState::undo_move(const ChessState& orig, minfo minfo) {
+template<class Board>
+void BasicChessState<Board>::undo_move(const BasicChessState& orig, minfo minfo) {
 
     // reset game data
     cast = orig.cast;
@@ -464,34 +432,34 @@ void ChessState::undo_move(const ChessState& orig, minfo minfo) {
     fmove = orig.fmove;
     active = orig.active;
 
-    vector<uint8_t> operations = {minfo.sq1,minfo.sq2};
+    uint8_t operations[4] = {minfo.sq1,minfo.sq2}; // squares whose pieces changed
+    uint8_t nops = 2;
     if(minfo.castle==QCAST) {
-        operations.push_back(minfo.sq1-minfo.sq1%SZ); // qrook at leftmost col
-        operations.push_back(minfo.sq2+1); // qrook ends up right of king
+        operations[nops++] = minfo.sq1-minfo.sq1%SZ; // qrook at leftmost col
+        operations[nops++] = minfo.sq2+1; // qrook ends up right of king
     } else if (minfo.castle==KCAST) {
-        operations.push_back(minfo.sq1-minfo.sq1%SZ+SZ-1); // krook at rightmost col
-        operations.push_back(minfo.sq2-1); // krook ends up left of king
+        operations[nops++] = minfo.sq1-minfo.sq1%SZ+SZ-1; // krook at rightmost col
+        operations[nops++] = minfo.sq2-1; // krook ends up left of king
     } 
     // pawn moved to enpassant square
     else if(minfo.sq2==orig.enpassant && map_type(minfo.newp)=='P') {
-        operations.push_back(minfo.sq1/SZ*SZ+minfo.sq2%SZ);
+        operations[nops++] = minfo.sq1/SZ*SZ+minfo.sq2%SZ;
     }
     
-    for(int idx=0;idx<operations.size();idx++) {
+    for(uint8_t idx=0;idx<nops;idx++) {
         uint8_t sq = operations[idx];
-        uint8_t& psq = board[sq/SZ][sq%SZ];
-        uint8_t opsq = orig.board[sq/SZ][sq%SZ];
-
-        // reset psquares
+        uint8_t psq = this->get(sq);
+        uint8_t opsq = orig.get(sq);
+        if(psq==opsq)
+            continue;
+        if(psq!=EMP)
+            this->remove(sq);
         if(opsq!=EMP)
-            psquares[opsq].insert(sq);
-        psquares[psq].erase(sq);
-        // reset board
-        psq = opsq;
+            this->put(sq,opsq);
     }
 }
 // static initialization
-vector<pair<int8_t,int8_t> > ChessState::knight_dirs = {pair<int8_t,int8_t>(-2,-1),
+vector<pair<int8_t,int8_t> > ChessTables::knight_dirs = {pair<int8_t,int8_t>(-2,-1),
                                 pair<int8_t,int8_t>(-2,1),
                                 pair<int8_t,int8_t>(2,-1),
                                 pair<int8_t,int8_t>(2,1),
@@ -499,7 +467,7 @@ vector<pair<int8_t,int8_t> > ChessState::knight_dirs = {pair<int8_t,int8_t>(-2,-
                                 pair<int8_t,int8_t>(-1,2),
                                 pair<int8_t,int8_t>(1,-2),
                                 pair<int8_t,int8_t>(1,2)};
-vector<pair<int8_t,int8_t> > ChessState::king_dirs = {pair<int8_t,int8_t>(-1,-1),
+vector<pair<int8_t,int8_t> > ChessTables::king_dirs = {pair<int8_t,int8_t>(-1,-1),
                                 pair<int8_t,int8_t>(-1,0),
                                 pair<int8_t,int8_t>(-1,1),
                                 pair<int8_t,int8_t>(0,-1),
@@ -507,7 +475,7 @@ vector<pair<int8_t,int8_t> > ChessState::king_dirs = {pair<int8_t,int8_t>(-1,-1)
                                 pair<int8_t,int8_t>(1,-1),
                                 pair<int8_t,int8_t>(1,0),
                                 pair<int8_t,int8_t>(1,1)};
-vector<pair<int8_t,int8_t> > ChessState::queen_dirs = {pair<int8_t,int8_t>(-1,-1),
+vector<pair<int8_t,int8_t> > ChessTables::queen_dirs = {pair<int8_t,int8_t>(-1,-1),
                                 pair<int8_t,int8_t>(-1,0),
                                 pair<int8_t,int8_t>(-1,1),
                                 pair<int8_t,int8_t>(0,-1),
@@ -515,16 +483,16 @@ vector<pair<int8_t,int8_t> > ChessState::queen_dirs = {pair<int8_t,int8_t>(-1,-1
                                 pair<int8_t,int8_t>(1,-1),
                                 pair<int8_t,int8_t>(1,0),
                                 pair<int8_t,int8_t>(1,1)};
-vector<pair<int8_t,int8_t> > ChessState::bishop_dirs = {pair<int8_t,int8_t>(-1,-1),
+vector<pair<int8_t,int8_t> > ChessTables::bishop_dirs = {pair<int8_t,int8_t>(-1,-1),
                                 pair<int8_t,int8_t>(-1,1),
                                 pair<int8_t,int8_t>(1,-1),
                                 pair<int8_t,int8_t>(1,1)};
-vector<pair<int8_t,int8_t> > ChessState::rook_dirs = {pair<int8_t,int8_t>(-1,0),
+vector<pair<int8_t,int8_t> > ChessTables::rook_dirs = {pair<int8_t,int8_t>(-1,0),
                                 pair<int8_t,int8_t>(1,0),
                                 pair<int8_t,int8_t>(0,-1),
                                 pair<int8_t,int8_t>(0,1)};
-string ChessState::promotions = "NBRQ";
-char ChessState::pchars[INV] = {[EMP]=' ',
+string ChessTables::promotions = "NBRQ";
+char ChessTables::pchars[INV] = {[EMP]=' ',
                   [WP]='P',
                   [WN]='N',
                   [WB]='B',
@@ -533,18 +501,18 @@ char ChessState::pchars[INV] = {[EMP]=' ',
                   [WK]='K',
                   [BP]='p',
                   [BN]='n',
-                  [BR]='r',
                   [BB]='b',
+                  [BR]='r',
                   [BQ]='q',
                   [BK]='k'}; // piece characters
 
 
-map<char,uint8_t> ChessState::char2p = {};
-map<char,uint8_t> ChessState::char2col = {};
+map<char,uint8_t> ChessTables::char2p = {};
+map<char,uint8_t> ChessTables::char2col = {};
 
-bool ChessState::char2p_filled = ChessState::fill_maps();
+bool ChessTables::char2p_filled = ChessTables::fill_maps();
 
-bool ChessState::fill_maps() {
+bool ChessTables::fill_maps() {
     for(int i=0; i<INV; i++) {
         char2p[pchars[i]] = i;
     }
@@ -554,76 +522,159 @@ bool ChessState::fill_maps() {
     return true;
 }
 
-char ChessState::cols[SZ] = {'a','b','c','d','e','f','g','h'};
+char ChessTables::cols[SZ] = {'a','b','c','d','e','f','g','h'};
+
+uint64_t ChessTables::zobrist_pieces[INV][SZ*SZ];
+uint64_t ChessTables::zobrist_cast[16];
+uint64_t ChessTables::zobrist_enpassant[SZ*SZ+1];
+uint64_t ChessTables::zobrist_black;
+
+bool ChessTables::zobrist_filled = ChessTables::fill_zobrist();
+
+bool ChessTables::fill_zobrist() {
+    // splitmix64 with a fixed seed, so hashes are the same in every run
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    auto next = [&seed]() {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+        z = (z^(z>>27))*0x94D049BB133111EBULL;
+        return z^(z>>31);
+    };
+    for(int p=0; p<INV; p++) {
+        for(int sq=0; sq<SZ*SZ; sq++)
+            zobrist_pieces[p][sq] = (p==EMP) ? 0 : next();
+    }
+    for(int c=0; c<16; c++)
+        zobrist_cast[c] = next();
+    for(int sq=0; sq<SZ*SZ; sq++)
+        zobrist_enpassant[sq] = next();
+    zobrist_enpassant[SZ*SZ] = 0; // not available
+    zobrist_black = next();
+    return true;
+}
 
-void ChessState::all_legal_moves(vector<minfo>& lmvlist,ChessState* backup) {
+uint64_t BitboardBoard::knight_masks[SZ*SZ];
+uint64_t BitboardBoard::king_masks[SZ*SZ];
+uint64_t BitboardBoard::pawn_masks[2][SZ*SZ];
+uint64_t BitboardBoard::rays[8][SZ*SZ];
+
+bool BitboardBoard::masks_filled = BitboardBoard::fill_masks();
+
+bool BitboardBoard::fill_masks() {
+    auto bit = [](int r, int c) { return (r<0||r>=SZ||c<0||c>=SZ) ? 0 : 1ULL<<(r*SZ+c); };
+    for(int sq=0; sq<SZ*SZ; sq++) {
+        int r = sq/SZ, c = sq%SZ;
+        knight_masks[sq] = king_masks[sq] = 0;
+        for(int d=0; d<8; d++) {
+            knight_masks[sq] |= bit(r+knight_offsets[d][0],c+knight_offsets[d][1]);
+            king_masks[sq] |= bit(r+king_offsets[d][0],c+king_offsets[d][1]);
+            rays[d][sq] = 0;
+            for(int i=1; bit(r+i*king_offsets[d][0],c+i*king_offsets[d][1]); i++)
+                rays[d][sq] |= bit(r+i*king_offsets[d][0],c+i*king_offsets[d][1]);
+        }
+        pawn_masks[WT][sq] = bit(r-1,c-1)|bit(r-1,c+1);
+        pawn_masks[BT][sq] = bit(r+1,c-1)|bit(r+1,c+1);
+    }
+    return true;
+}
+
+template<class Board>
+uint64_t BasicChessState<Board>::hash() const {
+    uint64_t h = 0;
+    for(uint8_t p=EMP+1; p<INV; p++) {
+        for(uint8_t sq: this->squares(p))
+            h ^= zobrist_pieces[p][sq];
+    }
+    h ^= zobrist_cast[cast];
+    h ^= zobrist_enpassant[(enpassant<SZ*SZ) ? enpassant : SZ*SZ];
+    if(active==BT)
+        h ^= zobrist_black;
+    return h;
+}
+
+template<class Board>
+bool BasicChessState<Board>::is_legal(minfo mv, BasicChessState* backup) {
+    // ex: active=W, play white's move on backup board
+    bool legal = false;
+    backup->execute_move(mv);
+    uint8_t ksq = *backup->squares((active==WT) ? WK : BK).begin();
+    if(!backup->is_checking(backup->active,ksq)) { // white king cannot be in check by black after white has moved
+        if (mv.castle==QCAST) // white king cannot move through check to castle
+            legal = !backup->is_checking(backup->active,ksq+1)&&!backup->is_checking(backup->active,ksq+2);
+        else if (mv.castle==KCAST)
+            legal = !backup->is_checking(backup->active,ksq-1)&&!backup->is_checking(backup->active,ksq-2);
+        else
+            legal = true;
+    }
+    // undo normal move
+    backup->undo_move(*this,mv);
+    return legal;
+}
+
+// pseudo-legal moves scratch list, reused so that legality filtering does not allocate
+static thread_local vector<minfo> pseudo_moves;
+
+template<class Board>
+void BasicChessState<Board>::all_legal_moves(vector<minfo>& lmvlist,BasicChessState* backup) {
+    STATS_SCOPE(PH_ALL_LEGAL_MOVES);
     // assumes current position is legal!
-    vector<minfo> mvlist;
-    all_moves(mvlist);
 
     // ChessInterface has its own backup boards that it updates after every move. 
-    // Otherwise, we have to dynamically allocate our own backup board
-    // to determine whether a move will put the king in check.
-    bool cleanup = false;
+    // Otherwise, we use a copy on the stack to determine whether a move will put the king in check.
     if(backup==NULL) {
-        backup =  new ChessState(*this);
-        cleanup = true;
-    }
-
-    for(minfo mv: mvlist) {
-        // ex: active=W, play white's move on backup board
-        backup->execute_move(mv);
-        uint8_t ksq = *backup->psquares[(active==WT) ? WK : BK].begin();
-        if(!backup->is_checking(backup->active,ksq)) { // white king cannot be in check by black after white has moved
-            if (mv.castle==QCAST) { // white king cannot move through check to castle
-                if(!backup->is_checking(backup->active,ksq+1)&&!backup->is_checking(backup->active,ksq+2))
-                    lmvlist.push_back(mv);
-            } else if (mv.castle==KCAST) {
-                if(!backup->is_checking(backup->active,ksq-1)&&!backup->is_checking(backup->active,ksq-2))
-                    lmvlist.push_back(mv);
-            } else {
-                lmvlist.push_back(mv);
-            }
-        }
-        // undo normal move
-        backup->undo_move(*this,mv);
+        BasicChessState local(*this);
+        return all_legal_moves(lmvlist,&local);
+    }
+
+    pseudo_moves.clear();
+    all_moves(pseudo_moves);
+    for(minfo mv: pseudo_moves) {
+        if(is_legal(mv,backup))
+            lmvlist.push_back(mv);
     }
-    // delete the backup if we dynamically allocated it
-    if(cleanup)
-        delete backup;
 }
 
-uint8_t ChessState::get_state(ChessState* backup) {
-    // ChessInterface has its own backup boards that it updates after every move. 
-    // Otherwise, we have to dynamically allocate our own backup board
-    // to determine whether a move will put the king in check.
-    bool cleanup = false;
+template<class Board>
+bool BasicChessState<Board>::has_legal_move(BasicChessState* backup) {
+    STATS_SCOPE(PH_HAS_LEGAL_MOVE);
+    // same as !all_legal_moves(...).empty(), but stops at the first legal move
     if(backup==NULL) {
-        backup =  new ChessState(*this);
-        cleanup = true;
+        BasicChessState local(*this);
+        return has_legal_move(&local);
+    }
+
+    pseudo_moves.clear();
+    all_moves(pseudo_moves);
+    for(minfo mv: pseudo_moves) {
+        if(is_legal(mv,backup))
+            return true;
     }
+    return false;
+}
 
-    uint8_t ksq = *psquares[(active==WT) ? WK : BK].begin();
+template<class Board>
+uint8_t BasicChessState<Board>::get_state(BasicChessState* backup) {
+    if(backup==NULL) {
+        BasicChessState local(*this);
+        return get_state(&local);
+    }
+
+    uint8_t ksq = *this->squares((active==WT) ? WK : BK).begin();
     bool check = is_checking(NEXT(active),ksq);
-    vector<minfo> lmvlist;
-    all_legal_moves(lmvlist,backup);
-    
-    if(cleanup)
-        delete backup; 
-    
-    if(check&&lmvlist.size()==0)
+    bool moves = has_legal_move(backup);
+
+    if(check&&!moves)
         return CHECKMATE;
     else if(check)
         return CHECK;
-    else if(lmvlist.size()==0)
+    else if(!moves)
         return DRAW;
     else
         return NORMAL;
-
-        
 }
-bool ChessState::is_checking(uint8_t sq1, uint8_t sq2) {
-    switch(map_type(board[sq1/SZ][sq1%SZ])) {
+template<class Board>
+bool BasicChessState<Board>::is_checking(uint8_t sq1, uint8_t sq2) {
+    switch(map_type(this->get(sq1))) {
         case 'P':
             return is_pawn_checking(sq1,sq2);
         case 'N':
@@ -640,26 +691,22 @@ bool ChessState::is_checking(uint8_t sq1, uint8_t sq2) {
             return true;
     }
 }
-bool ChessState::is_checking(bool attacker, uint8_t sq2) {
-    for(uint8_t i=EMP+1; i<INV; i++) {
-        if(IS_WHITE(i)!=(attacker==WT)) // only look at active pieces
-            continue;
-        for(uint8_t sq1: psquares[i]) {
-            if(is_checking(sq1,sq2))
-                return true;
-        }
-    }
-    return false;
+template<class Board>
+bool BasicChessState<Board>::is_checking(bool attacker, uint8_t sq2) {
+    STATS_SCOPE(PH_IS_CHECKING);
+    return this->attacked(sq2,attacker); // masks or walked rays, as the board policy keeps the pieces
 }
-bool ChessState::is_pawn_checking(uint8_t sq1, uint8_t sq2) {
-    uint8_t attacker = IS_WHITE(board[sq1/SZ][sq1%SZ])?WT:BT;
+template<class Board>
+bool BasicChessState<Board>::is_pawn_checking(uint8_t sq1, uint8_t sq2) {
+    uint8_t attacker = IS_WHITE(this->get(sq1))?WT:BT;
     // is pawn on sq1 checking sq2? pawn must be the same color as the active player
 
     // adjacent column. white r1 = r2+1 OR black r1 = r2-1.
     return (abs(sq1%SZ-sq2%SZ)==1)&&(((attacker==WT)&&(sq1/SZ-sq2/SZ == 1))||((attacker==BT)&&(sq2/SZ-sq1/SZ == 1)));
 }
 
-bool ChessState::is_limited_checking(uint8_t sq1, uint8_t sq2,vector<pair<int8_t,int8_t>>& dirs) {
+template<class Board>
+bool BasicChessState<Board>::is_limited_checking(uint8_t sq1, uint8_t sq2,vector<pair<int8_t,int8_t>>& dirs) {
     // ex: can a knight move on sq1 move to sq2?
     uint8_t r1 = sq1/SZ;
     uint8_t c1 = sq1%SZ;
@@ -671,14 +718,17 @@ bool ChessState::is_limited_checking(uint8_t sq1, uint8_t sq2,vector<pair<int8_t
     }
     return false;
 }
-bool ChessState::is_knight_checking(uint8_t sq1, uint8_t sq2) {
+template<class Board>
+bool BasicChessState<Board>::is_knight_checking(uint8_t sq1, uint8_t sq2) {
     return is_limited_checking(sq1,sq2,knight_dirs);
 }
-bool ChessState::is_king_checking(uint8_t sq1, uint8_t sq2) {
+template<class Board>
+bool BasicChessState<Board>::is_king_checking(uint8_t sq1, uint8_t sq2) {
     return is_limited_checking(sq1,sq2,king_dirs);
 }
 
-bool ChessState::is_unlimited_checking(uint8_t sq1, uint8_t sq2,vector<pair<int8_t,int8_t>>& dirs) {
+template<class Board>
+bool BasicChessState<Board>::is_unlimited_checking(uint8_t sq1, uint8_t sq2,vector<pair<int8_t,int8_t>>& dirs) {
     // ex: bishop, go along each diagonal until sq2 or non-empty. if sq2==sq3 return true
     uint8_t r1 = sq1/SZ;
     uint8_t c1 = sq1%SZ;
@@ -690,7 +740,7 @@ bool ChessState::is_unlimited_checking(uint8_t sq1, uint8_t sq2,vector<pair<int8
         r3 = r1+dir.first; // move forward
         c3 = c1+dir.second;
         // continue moving forward until sq2 or non-empty
-        while(!((r2==r3)&&(c2==c3))&&(ELEM(board,r3,c3)==EMP)) {
+        while(!((r2==r3)&&(c2==c3))&&(this->at(r3,c3)==EMP)) {
             r3+=dir.first;
             c3+=dir.second;
         }
@@ -700,12 +750,20 @@ bool ChessState::is_unlimited_checking(uint8_t sq1, uint8_t sq2,vector<pair<int8
     return false;
 }
 
-bool ChessState::is_bishop_checking(uint8_t sq1, uint8_t sq2) {
+template<class Board>
+bool BasicChessState<Board>::is_bishop_checking(uint8_t sq1, uint8_t sq2) {
     return is_unlimited_checking(sq1,sq2,bishop_dirs);
 }
-bool ChessState::is_rook_checking(uint8_t sq1, uint8_t sq2) {
+template<class Board>
+bool BasicChessState<Board>::is_rook_checking(uint8_t sq1, uint8_t sq2) {
     return is_unlimited_checking(sq1,sq2,rook_dirs);
 }
-bool ChessState::is_queen_checking(uint8_t sq1, uint8_t sq2) {
+template<class Board>
+bool BasicChessState<Board>::is_queen_checking(uint8_t sq1, uint8_t sq2) {
     return is_unlimited_checking(sq1,sq2,queen_dirs);
-}
\ No newline at end of file
+}
+
+template class BasicChessState<BitboardBoard>;
+template class BasicChessState<MailboxBoard>;
+template class BasicChessState<PieceListBoard>;
+template class BasicChessState<X88Board>;
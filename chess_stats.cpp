@@ -0,0 +1,78 @@
+#include "chess_stats.h"
+#include <deque>
+#include <mutex>
+#include <iomanip>
+
+bool ChessStats::enabled = false;
+
+const char* ChessStats::names[PH_COUNT] = {"all_moves",
+                                            "all_legal_moves",
+                                            "has_legal_move",
+                                            "is_checking",
+                                            "generate_notes",
+                                            "to_san",
+                                            "input"};
+
+static mutex stats_mutex;
+static deque<PhaseStats> stats_threads; // deque keeps references valid as threads register
+
+PhaseStats& ChessStats::local() {
+    thread_local PhaseStats* st = NULL;
+    if(st==NULL) {
+        lock_guard<mutex> lock(stats_mutex);
+        stats_threads.push_back(PhaseStats());
+        st = &stats_threads.back();
+        for(uint8_t ph=0; ph<PH_COUNT; ph++) {
+            st->calls[ph] = 0;
+            st->nanos[ph] = 0;
+        }
+    }
+    return *st;
+}
+
+void ChessStats::print(ostream& os, bool json) {
+    lock_guard<mutex> lock(stats_mutex);
+#ifndef CHESS_STATS
+    os << "warning: built without CHESS_STATS (make STATS=1), no phases were timed" << endl;
+#endif
+    PhaseStats total = {};
+    for(const PhaseStats& st: stats_threads) {
+        for(uint8_t ph=0; ph<PH_COUNT; ph++) {
+            total.calls[ph] += st.calls[ph];
+            total.nanos[ph] += st.nanos[ph];
+        }
+    }
+
+    if(json) {
+        os << "{\"threads\":[";
+        for(size_t t=0; t<=stats_threads.size(); t++) {
+            const PhaseStats& st = (t<stats_threads.size()) ? stats_threads[t] : total;
+            if(t==stats_threads.size())
+                os << "],\"total\":";
+            else if(t>0)
+                os << ",";
+            os << "{";
+            for(uint8_t ph=0; ph<PH_COUNT; ph++) {
+                os << (ph ? ",":"") << "\"" << names[ph] << "\":{\"calls\":" << st.calls[ph]
+                    << ",\"ns\":" << st.nanos[ph] << "}";
+            }
+            os << "}";
+        }
+        os << "}" << endl;
+        return;
+    }
+
+    os << left << setw(8) << "thread" << setw(18) << "phase" << right << setw(14) << "calls"
+        << setw(14) << "ms" << setw(12) << "ns/call" << endl;
+    for(size_t t=0; t<=stats_threads.size(); t++) {
+        const PhaseStats& st = (t<stats_threads.size()) ? stats_threads[t] : total;
+        for(uint8_t ph=0; ph<PH_COUNT; ph++) {
+            if(st.calls[ph]==0)
+                continue;
+            os << left << setw(8) << ((t<stats_threads.size()) ? to_string(t) : "total")
+                << setw(18) << names[ph] << right << setw(14) << st.calls[ph]
+                << setw(14) << fixed << setprecision(1) << st.nanos[ph]/1e6
+                << setw(12) << st.nanos[ph]/st.calls[ph] << endl;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef CHESS_STATS_H
+#define CHESS_STATS_H
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+using namespace std;
+
+// phases timed by STATS_SCOPE, times are inclusive (all_legal_moves contains all_moves and is_checking)
+#define PH_ALL_MOVES 0
+#define PH_ALL_LEGAL_MOVES 1
+#define PH_HAS_LEGAL_MOVE 2
+#define PH_IS_CHECKING 3
+#define PH_GENERATE_NOTES 4
+#define PH_TO_SAN 5
+#define PH_INPUT 6 // reading a move in one_play_input
+#define PH_COUNT 7
+
+struct PhaseStats { // counters of one thread
+    uint64_t calls[PH_COUNT];
+    uint64_t nanos[PH_COUNT];
+};
+
+class ChessStats {
+    public:
+        static bool enabled; // set by --stats, timers are skipped while false
+        static PhaseStats& local(); // this thread's counters, registered on first use
+        static void print(ostream& os, bool json=false); // per-thread and total summary
+        static const char* names[PH_COUNT];
+};
+
+class StatsTimer { // adds the lifetime of the timer to a phase
+    public:
+        StatsTimer(uint8_t phase) {
+            this->phase = phase;
+            if(ChessStats::enabled)
+                start = chrono::steady_clock::now();
+        }
+        ~StatsTimer() {
+            if(!ChessStats::enabled)
+                return;
+            PhaseStats& st = ChessStats::local();
+            st.calls[phase]++;
+            st.nanos[phase] += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-start).count();
+        }
+    private:
+        uint8_t phase;
+        chrono::steady_clock::time_point start;
+};
+
+// compile with -DCHESS_STATS (make STATS=1) to instrument, otherwise the timers compile away
+#ifdef CHESS_STATS
+#define STATS_SCOPE(phase) StatsTimer stats_timer_(phase)
+#else
+#define STATS_SCOPE(phase)
+#endif
+
+#endif
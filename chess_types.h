@@ -0,0 +1,71 @@
+#ifndef CHESS_TYPES_H
+#define CHESS_TYPES_H
+#include <iostream>
+#include <string>
+#include <regex>
+#include <set>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+#define SZ 8 // 8x8 board
+#define EMP 0 // empty square (no piece), minimum piece value must be EMP+1
+
+#define WP 1 // white pieces
+#define WN 2
+#define WB 3
+#define WR 4
+#define WQ 5
+#define WK 6 // king is max of white pieces
+#define IS_WHITE(piece) ((piece>EMP)&&(piece<BP))
+
+#define BP (WP+WK) // black pieces (greater than white pieces)
+#define BN (WN+WK)
+#define BB (WB+WK)
+#define BR (WR+WK)
+#define BQ (WQ+WK)
+#define BK (WK+WK)
+#define IS_BLACK(piece) ((piece>WK)&&(piece<INV))
+
+#define INV (BK+1) // invalid piece (out-of-bounds access, for example), INV must be greater than the other piece values and EMP
+#define ELEM(mat,i,j) (((i<0) || (i>=SZ) || (j<0) || (j>=SZ)) ? INV : mat[i][j])
+
+#define WT true // white's turn
+#define BT false // black's turn
+#define NEXT(t) ((t==WT) ? BT:WT)
+
+#define WKCAST 3 // castling availability for white king, binary position in cast
+#define WQCAST 2
+#define BKCAST 1
+#define BQCAST 0
+
+#define QCAST 1 // queenside castling
+#define KCAST 2 // kingside castling
+#define NCAST 0 // no castling
+
+#define MAX_MOVES 256 // upper bound on the number of legal moves in a position (218)
+
+#define WKSQ (SZ*(SZ-1)+4) // white king starting square
+#define BKSQ 4 // black king starting square
+
+// states: check, checkmate, draw, normal
+#define NORMAL 0
+#define CHECK 1
+#define CHECKMATE 2
+#define DRAW 3
+
+// results of a game, as seen by white
+#define WHITE_WINS 2
+#define DRAWN 1
+#define BLACK_WINS 0
+using namespace std;
+
+struct minfo { // info for a chess move
+    uint8_t sq1;
+    uint8_t sq2;
+    uint8_t newp;
+    uint8_t castle;
+};
+typedef struct minfo minfo;
+
+#endif
@@ -0,0 +1,391 @@
+#include "chess_interface.h"
+#include "pgn_reader.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <unordered_map>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+// opening frequencies, move popularity by rating band, results and game lengths of PGN files:
+// corpus_stats [--out prefix] [--format csv|json] [--threads N] [--plies N] [--band W] [--min-count N] file.pgn...
+// batches of games go to the workers, each keeps partial counts that are merged at the end
+// only the first --plies moves of a game are replayed: lengths and results come from the movetext and tags
+// csv writes prefix.openings.csv, prefix.moves.csv, prefix.results.csv and prefix.lengths.csv, json writes prefix.json
+
+#define BATCH_GAMES 256 // games handed to a worker at once
+#define UNRATED UINT16_MAX // rating band of games without Elo tags
+#define NO_RESULT 3 // "*" or missing, next to WHITE_WINS, DRAWN, BLACK_WINS
+
+struct StatsOptions {
+    uint32_t plies = 12; // opening positions and moves are counted up to this ply
+    uint32_t band = 200; // width of the rating bands
+    uint64_t min_count = 10; // openings and moves seen fewer times are not written
+};
+
+struct OpeningCount {
+    uint32_t ply = 0;
+    uint64_t games = 0;
+    uint64_t results[4] = {0,0,0,0}; // by result, see NO_RESULT
+    string line; // SAN moves reaching the position, the smallest one seen so that the output does not depend on threads
+};
+
+struct MoveKey {
+    uint64_t hash; // position before the move
+    uint16_t band; // rating band of the side to move
+    char san[SAN_MAX];
+    bool operator==(const MoveKey& o) const { return hash==o.hash&&band==o.band&&strcmp(san,o.san)==0; }
+};
+
+struct MoveKeyHash {
+    size_t operator()(const MoveKey& k) const {
+        uint64_t h = k.hash^(k.band*0x9E3779B97F4A7C15ULL);
+        for(const char* ch=k.san; *ch; ch++)
+            h = (h^(uint8_t)*ch)*0x100000001B3ULL;
+        return h;
+    }
+};
+
+struct MoveCount {
+    uint64_t games = 0;
+    uint64_t points = 0; // half points of the side that played the move, in games with a result
+    uint64_t decided = 0; // games with a result
+};
+
+struct CorpusStats { // partial counts of one worker, merged into the first one at the end
+    unordered_map<uint64_t,OpeningCount> openings;
+    unordered_map<MoveKey,MoveCount,MoveKeyHash> moves;
+    map<uint16_t,array<uint64_t,4> > results; // by rating band of the average rating
+    vector<uint64_t> lengths; // games by number of full moves
+    uint64_t games = 0;
+    uint64_t errors = 0; // games with an unreadable FEN or move in the replayed plies
+    ChessInterface game; // scratch
+
+    void merge(const CorpusStats& other);
+};
+
+static uint8_t parse_result(const string& res) {
+    if(res=="1-0") return WHITE_WINS;
+    if(res=="0-1") return BLACK_WINS;
+    if(res=="1/2-1/2") return DRAWN;
+    return NO_RESULT;
+}
+
+static uint16_t rating_band(int rating, uint32_t width) { // rating<=0: missing or "?"
+    return (rating>0) ? min<uint32_t>(rating/width*width,UNRATED-1) : UNRATED;
+}
+
+void CorpusStats::merge(const CorpusStats& other) {
+    for(auto& it: other.openings) {
+        OpeningCount& oc = openings[it.first];
+        if(oc.games==0||it.second.line<oc.line) {
+            oc.ply = it.second.ply;
+            oc.line = it.second.line;
+        }
+        oc.games += it.second.games;
+        for(int r=0; r<4; r++)
+            oc.results[r] += it.second.results[r];
+    }
+    for(auto& it: other.moves) {
+        MoveCount& mc = moves[it.first];
+        mc.games += it.second.games;
+        mc.points += it.second.points;
+        mc.decided += it.second.decided;
+    }
+    for(auto& it: other.results) {
+        array<uint64_t,4>& res = results.insert(make_pair(it.first,array<uint64_t,4>{{0,0,0,0}})).first->second;
+        for(int r=0; r<4; r++)
+            res[r] += it.second[r];
+    }
+    if(lengths.size()<other.lengths.size())
+        lengths.resize(other.lengths.size(),0);
+    for(size_t i=0; i<other.lengths.size(); i++)
+        lengths[i] += other.lengths[i];
+    games += other.games;
+    errors += other.errors;
+}
+
+static void count_games(const vector<PGNGame>& games, const StatsOptions& opts, CorpusStats& stats) {
+    ChessInterface& game = stats.game;
+    ChessState start;
+    MoveKey key;
+    minfo mv;
+    string line;
+    vector<uint64_t> seen; // positions of the current game, a repeated one counts once
+    vector<MoveKey> seen_moves;
+    for(const PGNGame& pgame: games) {
+        stats.games++;
+        uint8_t result = parse_result(pgame.result.empty()&&pgame.tag("Result") ? pgame.tag("Result") : pgame.result);
+        int welo = pgame.tag("WhiteElo") ? atoi(pgame.tag("WhiteElo")) : 0;
+        int belo = pgame.tag("BlackElo") ? atoi(pgame.tag("BlackElo")) : 0;
+        uint16_t wband = rating_band(welo,opts.band);
+        uint16_t bband = rating_band(belo,opts.band);
+        uint16_t band = (welo>0&&belo>0) ? rating_band((welo+belo)/2,opts.band) : UNRATED;
+        array<uint64_t,4>& res = stats.results.insert(make_pair(band,array<uint64_t,4>{{0,0,0,0}})).first->second;
+        res[result]++;
+        size_t fmoves = (pgame.moves.size()+1)/2;
+        if(stats.lengths.size()<=fmoves)
+            stats.lengths.resize(fmoves+1,0);
+        stats.lengths[fmoves]++;
+
+        if(pgame.tag("FEN")) // openings only from the standard start
+            continue;
+        game.set_state(start);
+        line.clear();
+        seen.clear();
+        seen_moves.clear();
+        for(size_t ply=0; ply<=pgame.moves.size()&&ply<=opts.plies; ply++) {
+            uint64_t h = game.hash();
+            if(find(seen.begin(),seen.end(),h)==seen.end()) {
+                seen.push_back(h);
+                OpeningCount& oc = stats.openings[h];
+                if(oc.games==0||line<oc.line) {
+                    oc.ply = ply;
+                    oc.line = line;
+                }
+                oc.games++;
+                oc.results[result]++;
+            }
+            if(ply==pgame.moves.size()||ply==opts.plies)
+                break;
+            if(!game.parse_san(pgame.moves[ply].c_str(),mv)) {
+                stats.errors++;
+                break;
+            }
+            memset(&key,0,sizeof(key));
+            key.hash = h;
+            key.band = (game.active==WT) ? wband : bband;
+            game.to_san(mv,key.san);
+            if(find(seen_moves.begin(),seen_moves.end(),key)==seen_moves.end()) {
+                seen_moves.push_back(key);
+                MoveCount& mc = stats.moves[key];
+                mc.games++;
+                if(result!=NO_RESULT) {
+                    mc.decided++;
+                    mc.points += (game.active==WT) ? result : 2-result; // WHITE_WINS, DRAWN, BLACK_WINS are 2, 1, 0
+                }
+            }
+            if(!line.empty())
+                line += ' ';
+            if(game.active==WT)
+                line += to_string(game.fmove)+". ";
+            line += key.san;
+            game.move(mv);
+        }
+    }
+}
+
+// sorted output rows: openings by frequency, moves by position, band and frequency
+static vector<pair<uint64_t,const OpeningCount*> > sorted_openings(const CorpusStats& stats, uint64_t min_count) {
+    vector<pair<uint64_t,const OpeningCount*> > rows;
+    for(auto& it: stats.openings)
+        if(it.second.games>=min_count)
+            rows.push_back(make_pair(it.first,&it.second));
+    sort(rows.begin(),rows.end(),[](const pair<uint64_t,const OpeningCount*>& a, const pair<uint64_t,const OpeningCount*>& b) {
+        return a.second->games!=b.second->games ? a.second->games>b.second->games : a.first<b.first;
+    });
+    return rows;
+}
+
+static vector<pair<const MoveKey*,const MoveCount*> > sorted_moves(const CorpusStats& stats, uint64_t min_count) {
+    vector<pair<const MoveKey*,const MoveCount*> > rows;
+    for(auto& it: stats.moves)
+        if(it.second.games>=min_count)
+            rows.push_back(make_pair(&it.first,&it.second));
+    sort(rows.begin(),rows.end(),[](const pair<const MoveKey*,const MoveCount*>& a, const pair<const MoveKey*,const MoveCount*>& b) {
+        if(a.first->hash!=b.first->hash)
+            return a.first->hash<b.first->hash;
+        if(a.first->band!=b.first->band)
+            return a.first->band<b.first->band;
+        if(a.second->games!=b.second->games)
+            return a.second->games>b.second->games;
+        return strcmp(a.first->san,b.first->san)<0;
+    });
+    return rows;
+}
+
+static string hex_hash(uint64_t h) {
+    char buf[17];
+    snprintf(buf,sizeof(buf),"%016llx",(unsigned long long)h);
+    return buf;
+}
+
+static string band_text(uint16_t band, const char* unrated) {
+    return (band==UNRATED) ? unrated : to_string(band);
+}
+
+static string score_text(const MoveCount& mc) {
+    char buf[16];
+    if(mc.decided==0)
+        return "";
+    snprintf(buf,sizeof(buf),"%.3f",mc.points/(2.0*mc.decided));
+    return buf;
+}
+
+static bool write_csv(const CorpusStats& stats, const StatsOptions& opts, const string& prefix) {
+    ofstream fo(prefix+".openings.csv"), fm(prefix+".moves.csv"), fr(prefix+".results.csv"), fl(prefix+".lengths.csv");
+    if(!fo||!fm||!fr||!fl)
+        return false;
+    fo << "hash,ply,games,white_wins,draws,black_wins,line" << endl;
+    for(auto& row: sorted_openings(stats,opts.min_count)) {
+        const OpeningCount& oc = *row.second;
+        fo << hex_hash(row.first) << ',' << oc.ply << ',' << oc.games << ',' << oc.results[WHITE_WINS] << ','
+            << oc.results[DRAWN] << ',' << oc.results[BLACK_WINS] << ",\"" << oc.line << '"' << endl;
+    }
+    fm << "hash,band,san,games,score" << endl;
+    for(auto& row: sorted_moves(stats,opts.min_count))
+        fm << hex_hash(row.first->hash) << ',' << band_text(row.first->band,"") << ',' << row.first->san << ','
+            << row.second->games << ',' << score_text(*row.second) << endl;
+    fr << "band,games,white_wins,draws,black_wins,unknown" << endl;
+    for(auto& it: stats.results)
+        fr << band_text(it.first,"") << ',' << it.second[0]+it.second[1]+it.second[2]+it.second[3] << ',' << it.second[WHITE_WINS]
+            << ',' << it.second[DRAWN] << ',' << it.second[BLACK_WINS] << ',' << it.second[NO_RESULT] << endl;
+    fl << "moves,games" << endl;
+    for(size_t i=0; i<stats.lengths.size(); i++)
+        if(stats.lengths[i])
+            fl << i << ',' << stats.lengths[i] << endl;
+    return fo.good()&&fm.good()&&fr.good()&&fl.good();
+}
+
+static bool write_json(const CorpusStats& stats, const StatsOptions& opts, const string& prefix) {
+    // SAN and move numbers need no escaping
+    ofstream out(prefix+".json");
+    if(!out)
+        return false;
+    out << "{\"games\":" << stats.games << ",\"errors\":" << stats.errors << ",\"plies\":" << opts.plies
+        << ",\"band\":" << opts.band << ",\n\"openings\":[";
+    bool first = true;
+    for(auto& row: sorted_openings(stats,opts.min_count)) {
+        const OpeningCount& oc = *row.second;
+        out << (first ? "\n" : ",\n") << "{\"hash\":\"" << hex_hash(row.first) << "\",\"ply\":" << oc.ply << ",\"games\":" << oc.games
+            << ",\"white_wins\":" << oc.results[WHITE_WINS] << ",\"draws\":" << oc.results[DRAWN] << ",\"black_wins\":"
+            << oc.results[BLACK_WINS] << ",\"line\":\"" << oc.line << "\"}";
+        first = false;
+    }
+    out << "],\n\"moves\":[";
+    first = true;
+    for(auto& row: sorted_moves(stats,opts.min_count)) {
+        string score = score_text(*row.second);
+        out << (first ? "\n" : ",\n") << "{\"hash\":\"" << hex_hash(row.first->hash) << "\",\"band\":" << band_text(row.first->band,"null")
+            << ",\"san\":\"" << row.first->san << "\",\"games\":" << row.second->games << ",\"score\":" << (score.empty() ? "null" : score) << "}";
+        first = false;
+    }
+    out << "],\n\"results\":[";
+    first = true;
+    for(auto& it: stats.results) {
+        out << (first ? "\n" : ",\n") << "{\"band\":" << band_text(it.first,"null") << ",\"games\":" << it.second[0]+it.second[1]+it.second[2]+it.second[3]
+            << ",\"white_wins\":" << it.second[WHITE_WINS] << ",\"draws\":" << it.second[DRAWN] << ",\"black_wins\":" << it.second[BLACK_WINS]
+            << ",\"unknown\":" << it.second[NO_RESULT] << "}";
+        first = false;
+    }
+    out << "],\n\"lengths\":[";
+    first = true;
+    for(size_t i=0; i<stats.lengths.size(); i++) {
+        if(!stats.lengths[i])
+            continue;
+        out << (first ? "\n" : ",\n") << "{\"moves\":" << i << ",\"games\":" << stats.lengths[i] << "}";
+        first = false;
+    }
+    out << "]}" << endl;
+    return out.good();
+}
+
+int main(int argc, char** argv) {
+    string prefix = "stats";
+    string format = "csv";
+    uint32_t nthreads = thread::hardware_concurrency();
+    StatsOptions opts;
+    vector<string> paths;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--out"&&i+1<argc) prefix = argv[++i];
+        else if(opt=="--format"&&i+1<argc) format = argv[++i];
+        else if(opt=="--threads"&&i+1<argc) nthreads = atoi(argv[++i]);
+        else if(opt=="--plies"&&i+1<argc) opts.plies = atoi(argv[++i]);
+        else if(opt=="--band"&&i+1<argc) opts.band = max(1,atoi(argv[++i]));
+        else if(opt=="--min-count"&&i+1<argc) opts.min_count = atoll(argv[++i]);
+        else if(opt[0]=='-') {
+            cerr << "usage: " << argv[0] << " [--out prefix] [--format csv|json] [--threads N] [--plies N] [--band W] [--min-count N] file.pgn..." << endl;
+            return 1;
+        } else
+            paths.push_back(opt);
+    }
+    if(format!="csv"&&format!="json") {
+        cerr << "usage: " << argv[0] << " [--out prefix] [--format csv|json] [--threads N] [--plies N] [--band W] [--min-count N] file.pgn..." << endl;
+        return 1;
+    }
+
+    for(const string& path: paths) { // before any job is queued
+        if(!ifstream(path)) {
+            cerr << "cannot open " << path << endl;
+            return 1;
+        }
+    }
+
+    auto stime = chrono::steady_clock::now();
+    // declared before the pool, whose destructor finishes the jobs using them
+    vector<CorpusStats> partials(max(nthreads,1U));
+    mutex flight_lock;
+    condition_variable flight_done;
+    uint32_t in_flight = 0; // batches queued or being counted, bounds the games in memory
+    ThreadPool pool(partials.size());
+
+    // batch i goes to worker i%N, so each partial is only touched by one thread
+    uint64_t nbatches = 0;
+    vector<PGNGame>* batch = new vector<PGNGame>();
+    PGNGame pgame;
+    for(const string& path: paths) {
+        ifstream fin(path);
+        PGNReader reader(fin);
+        while(true) {
+            bool more = reader.next(pgame);
+            if(more)
+                batch->push_back(pgame);
+            if(batch->size()==BATCH_GAMES||(!more&&!batch->empty())) {
+                {
+                    unique_lock<mutex> lock(flight_lock);
+                    flight_done.wait(lock,[&]() { return in_flight<4*pool.size(); });
+                    in_flight++;
+                }
+                uint32_t worker = nbatches++%pool.size();
+                pool.submit(worker,[batch,&opts,&partials,worker,&flight_lock,&flight_done,&in_flight]() {
+                    count_games(*batch,opts,partials[worker]);
+                    delete batch;
+                    lock_guard<mutex> lock(flight_lock);
+                    in_flight--;
+                    flight_done.notify_one();
+                });
+                batch = new vector<PGNGame>();
+            }
+            if(!more)
+                break;
+        }
+    }
+    delete batch;
+    pool.wait();
+
+    // pairwise merges in parallel, halving the partials every round
+    for(size_t step=1; step<partials.size(); step*=2) {
+        for(size_t i=0; i+step<partials.size(); i+=2*step) {
+            pool.submit([&partials,i,step]() {
+                partials[i].merge(partials[i+step]);
+                partials[i+step] = CorpusStats();
+            });
+        }
+        pool.wait();
+    }
+    const CorpusStats& stats = partials[0];
+    bool ok = (format=="json") ? write_json(stats,opts,prefix) : write_csv(stats,opts,prefix);
+    if(!ok) {
+        cerr << "cannot write " << prefix << ((format=="json") ? ".json" : ".*.csv") << endl;
+        return 1;
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+    cout << stats.games << " games, " << stats.openings.size() << " opening positions, " << stats.moves.size() << " moves, "
+        << stats.errors << " games with errors, " << secs << "s (" << (uint64_t)(stats.games/secs) << " games/s)" << endl;
+    return 0;
+}
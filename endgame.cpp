@@ -0,0 +1,76 @@
+#include "chess_interface.h"
+#include "tablebase.h"
+#include <chrono>
+#include <cstdlib>
+
+// generates and probes endgame tablebases:
+// endgame [--dir DIR] [--threads N] gen KQK KRK ... (writes DIR/KQK.ctb, with the sub-tables it needs)
+// endgame [--dir DIR] probe FEN (prints the result and the best line)
+
+static int generate(TablebaseSet& set, const vector<string>& sigs) {
+    for(const string& sig: sigs) {
+        auto stime = chrono::steady_clock::now();
+        const Tablebase& tb = set.get(sig);
+        double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+        uint64_t wins = 0, draws = 0, losses = 0;
+        uint8_t longest = 0;
+        for(uint32_t idx=0; idx<tb.size(); idx++) {
+            uint8_t val = tb.value(idx);
+            if(val==TB_DRAW)
+                draws++;
+            else if(val!=TB_ILLEGAL) {
+                (val%2 ? wins : losses)++;
+                longest = max(longest,val);
+            }
+        }
+        cout << sig << ": " << wins << " wins, " << draws << " draws, " << losses << " losses, longest mate "
+            << (longest+1)/2 << " moves, " << secs << "s" << endl;
+    }
+    return 0;
+}
+
+static int probe(TablebaseSet& set, const string& fen) {
+    ChessInterface game;
+    game.set_state(ChessState(fen));
+    TBResult res;
+    if(!set.probe(game,res)) {
+        cerr << "no tablebase for " << fen << endl;
+        return 1;
+    }
+    if(res.wdl==0)
+        cout << "draw" << endl;
+    else
+        cout << ((res.wdl>0) ? "win" : "loss") << " in " << (res.dtm+1)/2 << " moves (" << int(res.dtm) << " plies)" << endl;
+    minfo mv;
+    for(uint8_t ply=0; ply<res.dtm&&set.best_move(game,mv); ply++) {
+        cout << game.to_san(mv) << " ";
+        game.move(mv);
+    }
+    cout << endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    string dir = ".";
+    uint32_t nthreads = thread::hardware_concurrency();
+    vector<string> args;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--dir"&&i+1<argc) dir = argv[++i];
+        else if(opt=="--threads"&&i+1<argc) nthreads = atoi(argv[++i]);
+        else args.push_back(opt);
+    }
+    try {
+        TablebaseSet set(dir,nthreads);
+        if(args.size()>1&&args[0]=="gen")
+            return generate(set,vector<string>(args.begin()+1,args.end()));
+        if(args.size()==2&&args[0]=="probe")
+            return probe(set,args[1]);
+    } catch(const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    cerr << "usage: " << argv[0] << " [--dir DIR] [--threads N] gen KQK KRK ..." << endl
+        << "       " << argv[0] << " [--dir DIR] probe FEN" << endl;
+    return 1;
+}
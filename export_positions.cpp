@@ -0,0 +1,181 @@
+#include "chess_interface.h"
+#include "pgn_reader.h"
+#include "packed_position.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+// replays PGN games and writes sampled positions as PackedPosition records, one shard file per thread:
+// export_positions [--out prefix] [--threads N] [--skip K] [--no-captures] [--no-checks] file.pgn...
+// writes prefix.0.bin .. prefix.N-1.bin
+
+#define BATCH_GAMES 256 // games handed to a worker at once
+#define FLUSH_RECORDS 4096
+
+struct ExportOptions {
+    uint32_t skip = 8; // first plies of every game that are not exported
+    bool no_captures = false; // skip positions where the played move captures
+    bool no_checks = false; // skip positions where the side to move is in check
+};
+
+struct Shard { // only touched by its worker
+    FILE* file = NULL;
+    ChessInterface game;
+    vector<PackedPosition> buf;
+    uint64_t games = 0;
+    uint64_t positions = 0;
+    uint64_t errors = 0; // games with an illegal or unreadable move
+    bool failed = false; // a write came up short, e.g. disk full
+
+    void flush() {
+        if(fwrite(buf.data(),sizeof(PackedPosition),buf.size(),file)!=buf.size())
+            failed = true;
+        positions += buf.size();
+        buf.clear();
+    }
+};
+
+static uint8_t parse_result(const string& res) {
+    if(res=="1-0") return WHITE_WINS;
+    if(res=="0-1") return BLACK_WINS;
+    if(res=="1/2-1/2") return DRAWN;
+    return UNKNOWN_RESULT;
+}
+
+static void export_games(const vector<PGNGame>& games, const ExportOptions& opts, Shard& shard) {
+    ChessState start;
+    ChessInterface& game = shard.game;
+    PackedPosition rec;
+    minfo mv;
+    for(const PGNGame& pgame: games) {
+        try {
+            game.set_state(pgame.tag("FEN") ? ChessState(pgame.tag("FEN")) : start);
+        } catch(const invalid_argument& e) {
+            shard.errors++;
+            continue;
+        }
+        uint8_t result = parse_result(pgame.result.empty()&&pgame.tag("Result") ? pgame.tag("Result") : pgame.result);
+        shard.games++;
+        for(size_t ply=0; ply<pgame.moves.size(); ply++) {
+            if(!game.parse_san(pgame.moves[ply].c_str(),mv)) {
+                shard.errors++;
+                break;
+            }
+            bool keep = ply>=opts.skip;
+            if(keep&&opts.no_captures) {
+                uint8_t p1 = game.board[mv.sq1/SZ][mv.sq1%SZ];
+                keep = game.board[mv.sq2/SZ][mv.sq2%SZ]==EMP&&!((p1==WP||p1==BP)&&mv.sq2==game.enpassant);
+            }
+            if(keep&&opts.no_checks)
+                keep = !game.is_checking(NEXT(game.active),*game.psquares[(game.active==WT) ? WK : BK].begin());
+            if(keep) {
+                pack_position(game,mv,result,rec);
+                shard.buf.push_back(rec);
+            }
+            game.move(mv);
+        }
+        if(shard.buf.size()>=FLUSH_RECORDS)
+            shard.flush();
+    }
+}
+
+int main(int argc, char** argv) {
+    string prefix = "positions";
+    uint32_t nthreads = thread::hardware_concurrency();
+    ExportOptions opts;
+    vector<string> paths;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--out"&&i+1<argc) prefix = argv[++i];
+        else if(opt=="--threads"&&i+1<argc) nthreads = atoi(argv[++i]);
+        else if(opt=="--skip"&&i+1<argc) opts.skip = atoi(argv[++i]);
+        else if(opt=="--no-captures") opts.no_captures = true;
+        else if(opt=="--no-checks") opts.no_checks = true;
+        else if(opt[0]=='-') {
+            cerr << "usage: " << argv[0] << " [--out prefix] [--threads N] [--skip K] [--no-captures] [--no-checks] file.pgn..." << endl;
+            return 1;
+        } else
+            paths.push_back(opt);
+    }
+
+    for(const string& path: paths) { // before any job is queued
+        if(!ifstream(path)) {
+            cerr << "cannot open " << path << endl;
+            return 1;
+        }
+    }
+
+    auto stime = chrono::steady_clock::now();
+    // declared before the pool, whose destructor finishes the jobs using them
+    vector<Shard> shards(max(nthreads,1U));
+    mutex flight_lock;
+    condition_variable flight_done;
+    uint32_t in_flight = 0; // batches queued or being exported, bounds the games in memory
+    for(uint32_t w=0; w<shards.size(); w++) {
+        string path = prefix+"."+to_string(w)+".bin";
+        shards[w].file = fopen(path.c_str(),"wb");
+        if(shards[w].file==NULL) {
+            cerr << "cannot write " << path << endl;
+            return 1;
+        }
+        shards[w].buf.reserve(FLUSH_RECORDS+MAX_MOVES*2);
+    }
+    ThreadPool pool(shards.size());
+
+    // batch i goes to worker i%N, so each shard file is written by a single thread
+    uint64_t nbatches = 0;
+    vector<PGNGame>* batch = new vector<PGNGame>();
+    PGNGame pgame;
+    for(const string& path: paths) {
+        ifstream fin(path);
+        PGNReader reader(fin);
+        while(true) {
+            bool more = reader.next(pgame);
+            if(more)
+                batch->push_back(pgame);
+            if(batch->size()==BATCH_GAMES||(!more&&!batch->empty())) {
+                {
+                    unique_lock<mutex> lock(flight_lock);
+                    flight_done.wait(lock,[&]() { return in_flight<4*pool.size(); });
+                    in_flight++;
+                }
+                uint32_t worker = nbatches++%pool.size();
+                pool.submit(worker,[batch,&opts,&shards,worker,&flight_lock,&flight_done,&in_flight]() {
+                    export_games(*batch,opts,shards[worker]);
+                    delete batch;
+                    lock_guard<mutex> lock(flight_lock);
+                    in_flight--;
+                    flight_done.notify_one();
+                });
+                batch = new vector<PGNGame>();
+            }
+            if(!more)
+                break;
+        }
+    }
+    delete batch;
+    pool.wait();
+
+    uint64_t games = 0, positions = 0, errors = 0;
+    bool failed = false;
+    for(Shard& shard: shards) {
+        shard.flush();
+        if(fclose(shard.file)!=0)
+            shard.failed = true;
+        failed |= shard.failed;
+        games += shard.games;
+        positions += shard.positions;
+        errors += shard.errors;
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+    cout << games << " games, " << positions << " positions in " << shards.size() << " shards, "
+        << errors << " games with errors, " << secs << "s (" << (uint64_t)(positions/secs) << " positions/s)" << endl;
+    if(failed) {
+        cerr << "cannot write all positions to " << prefix << ".*.bin" << endl;
+        return 1;
+    }
+    return 0;
+}
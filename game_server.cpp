@@ -0,0 +1,276 @@
+#include "game_server.h"
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define REQUEST_MAX 4096 // longest request line, a client that sends a longer one is dropped
+#define OUTPUT_MAX (1<<22) // unsent response bytes of a connection before it is dropped
+
+static const char* state_names[] = {[NORMAL]="NORMAL",
+                                    [CHECK]="CHECK",
+                                    [CHECKMATE]="CHECKMATE",
+                                    [DRAW]="DRAW"};
+
+GameServer::Connection::~Connection() {
+    close(fd);
+}
+
+bool GameServer::Connection::queue(const string& response) {
+    lock_guard<mutex> lock(wlock);
+    if(dead)
+        return false;
+    bool was_empty = outbuf.empty();
+    outbuf += response;
+    if(outbuf.size()>OUTPUT_MAX) { // the client does not read its responses
+        dead = true;
+        outbuf.clear();
+        return true;
+    }
+    return was_empty;
+}
+
+bool GameServer::Connection::flush() {
+    lock_guard<mutex> lock(wlock);
+    size_t done = 0;
+    while(!dead&&done<outbuf.size()) {
+        ssize_t n = ::send(fd,outbuf.data()+done,outbuf.size()-done,MSG_NOSIGNAL);
+        if(n<0&&errno==EINTR)
+            continue;
+        if(n<0&&(errno==EAGAIN||errno==EWOULDBLOCK)) // the rest when poll() reports POLLOUT
+            break;
+        if(n<=0)
+            dead = true;
+        else
+            done += n;
+    }
+    outbuf.erase(0,dead ? outbuf.size() : done);
+    return !dead;
+}
+
+bool GameServer::Connection::pending() {
+    lock_guard<mutex> lock(wlock);
+    return !outbuf.empty();
+}
+
+static void set_nonblocking(int fd) {
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL)|O_NONBLOCK);
+}
+
+GameServer::GameServer(const string& path, uint32_t nworkers) : path(path), running(false), next_id(1), ngames(0),
+        pool(nworkers), sessions(pool.size()) {
+    listen_fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(listen_fd<0)
+        throw runtime_error("cannot create socket");
+    sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size()>=sizeof(addr.sun_path))
+        throw invalid_argument(path+" is too long for a socket path");
+    strcpy(addr.sun_path,path.c_str());
+    unlink(path.c_str());
+    if(::bind(listen_fd,(sockaddr*)&addr,sizeof(addr))<0||listen(listen_fd,SOMAXCONN)<0)
+        throw runtime_error("cannot listen on "+path);
+    if(pipe(wake_fds)<0)
+        throw runtime_error("cannot create pipe");
+    set_nonblocking(wake_fds[0]);
+    set_nonblocking(wake_fds[1]); // a full pipe already wakes poll()
+}
+
+GameServer::~GameServer() {
+    pool.wait();
+    for(auto& worker_sessions: sessions) {
+        for(auto& it: worker_sessions)
+            delete it.second;
+    }
+    close(listen_fd);
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    unlink(path.c_str());
+}
+
+size_t GameServer::games() {
+    return ngames;
+}
+
+void GameServer::stop() {
+    running = false;
+    wake();
+}
+
+void GameServer::wake() {
+    char ch = 0;
+    if(write(wake_fds[1],&ch,1)<0) {} // poll() returns
+}
+
+void GameServer::run() {
+    running = true;
+    vector<pollfd> fds;
+    vector<shared_ptr<Connection> > conns; // conns[i] polls on fds[i+2]
+    char buf[1<<16];
+    while(running) {
+        fds.resize(2);
+        fds[0] = {listen_fd,POLLIN,0};
+        fds[1] = {wake_fds[0],POLLIN,0};
+        for(auto& conn: conns) {
+            bool out = conn->pending();
+            if(conn->closing&&!out) // waits for the workers' wake-up, a hung-up socket would report POLLHUP forever
+                fds.push_back({-1,0,0});
+            else
+                fds.push_back({conn->fd,(short)((conn->closing ? 0 : POLLIN)|(out ? POLLOUT : 0)),0});
+        }
+        if(poll(fds.data(),fds.size(),-1)<0)
+            continue; // EINTR
+        if(fds[1].revents&POLLIN) {
+            while(read(wake_fds[0],buf,sizeof(buf))>0) {}
+        }
+
+        for(size_t i=0; i<conns.size(); i++) {
+            Connection& conn = *conns[i];
+            bool drop = false;
+            if(!conn.closing&&fds[i+2].revents) {
+                ssize_t n = read(conn.fd,buf,sizeof(buf));
+                if(n==0||(n<0&&errno!=EAGAIN&&errno!=EINTR)) { // closed: queued requests are still answered
+                    conn.closing = true;
+                    end_games(conns[i]);
+                } else if(n>0) {
+                    // split complete lines, keep the rest for the next read
+                    string& inbuf = conn.inbuf;
+                    inbuf.append(buf,n);
+                    size_t start = 0;
+                    size_t end;
+                    while((end=inbuf.find('\n',start))!=string::npos) {
+                        dispatch(conns[i],inbuf.substr(start,end-start));
+                        start = end+1;
+                    }
+                    inbuf.erase(0,start);
+                    drop = inbuf.size()>REQUEST_MAX;
+                }
+            }
+            // responses the workers queued since the last round, as far as the socket takes them
+            drop = !conn.flush()||drop;
+            if(drop&&!conn.closing) {
+                conn.closing = true;
+                end_games(conns[i]);
+            }
+            if(drop||(conn.closing&&conn.jobs==0&&!conn.pending())) {
+                shutdown(conn.fd,SHUT_RDWR);
+                conns[i].reset(); // the workers' jobs still hold it, their responses are dropped
+            }
+        }
+        conns.erase(remove(conns.begin(),conns.end(),shared_ptr<Connection>()),conns.end());
+
+        if(fds[0].revents&POLLIN) {
+            int fd = accept(listen_fd,NULL,NULL);
+            if(fd>=0) {
+                // workers never write to the socket, a client that does not read cannot stall their games
+                set_nonblocking(fd);
+                conns.push_back(make_shared<Connection>(fd,pool.size()));
+            }
+        }
+    }
+}
+
+void GameServer::dispatch(const shared_ptr<Connection>& conn, const string& request) {
+    // the I/O thread only reads the command and game id, the game's worker does the rest
+    stringstream ss(request);
+    string cmd;
+    uint64_t id = 0;
+    ss >> cmd;
+    if(cmd.empty())
+        return;
+    if(cmd=="NEW")
+        id = next_id++;
+    else if(!(ss >> id)) {
+        conn->queue("ERR 0 missing game id\n"); // sent by run() right after this round
+        return;
+    }
+    string args;
+    getline(ss,args);
+    args.erase(0,args.find_first_not_of(' '));
+
+    uint32_t worker = id%pool.size();
+    conn->jobs++;
+    pool.submit(worker,[this,conn,worker,id,cmd,args]() {
+        string response;
+        process(worker,conn.get(),id,cmd,args,response);
+        bool need_wake = conn->queue(response);
+        if(--conn->jobs==0&&conn->closing) // the I/O thread may be waiting for the last answer to close it
+            need_wake = true;
+        if(need_wake)
+            wake();
+    });
+}
+
+void GameServer::end_games(const shared_ptr<Connection>& conn) {
+    // each worker ends its own games, after the requests already queued for it
+    for(uint32_t worker=0; worker<pool.size(); worker++) {
+        pool.submit(worker,[this,conn,worker]() {
+            unordered_map<uint64_t,Session*>& table = sessions[worker];
+            for(uint64_t id: conn->games[worker]) {
+                delete table[id];
+                table.erase(id);
+                ngames--;
+            }
+            conn->games[worker].clear();
+        });
+    }
+}
+
+void GameServer::process(uint32_t worker, Connection* conn, uint64_t id, const string& cmd, const string& args, string& response) {
+    unordered_map<uint64_t,Session*>& table = sessions[worker];
+    string sid = to_string(id);
+    if(cmd=="NEW") {
+        Session* ses = new Session();
+        ses->owner = conn;
+        try {
+            if(!args.empty())
+                ses->game.set_state(ChessState(args));
+        } catch(const invalid_argument& e) {
+            delete ses;
+            response = "ERR "+sid+" invalid FEN\n";
+            return;
+        }
+        table[id] = ses;
+        conn->games[worker].insert(id);
+        ngames++;
+        response = "OK "+sid+"\n";
+        return;
+    }
+
+    auto it = table.find(id);
+    if(it==table.end()||it->second->owner!=conn) { // another client's game is not revealed
+        response = "ERR "+sid+" unknown game\n";
+        return;
+    }
+    ChessInterface& game = it->second->game;
+    if(cmd=="MOVE") {
+        if(args.size()>=SAN_MAX||!(game.play_san(args.c_str())||game.play_uci(args.c_str())))
+            response = "ERR "+sid+" illegal move "+args+"\n";
+        else
+            response = "OK "+sid+" "+state_names[game.get_state()]+"\n";
+    } else if(cmd=="LEGAL") {
+        response = "OK "+sid;
+        for(const note& nt: game.notes()) {
+            response += ' ';
+            response += nt.san;
+        }
+        response += '\n';
+    } else if(cmd=="STATE") {
+        response = "OK "+sid+" "+state_names[game.get_state()]+"\n";
+    } else if(cmd=="FEN") {
+        response = "OK "+sid+" "+game.get_FEN()+"\n";
+    } else if(cmd=="END") {
+        delete it->second;
+        table.erase(it);
+        conn->games[worker].erase(id);
+        ngames--;
+        response = "OK "+sid+"\n";
+    } else
+        response = "ERR "+sid+" unknown command "+cmd+"\n";
+}
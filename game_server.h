@@ -0,0 +1,64 @@
+#ifndef GAME_SERVER_H
+#define GAME_SERVER_H
+#include "chess_interface.h"
+#include "thread_pool.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+
+// serves many games over a Unix domain socket, one request and one response per line:
+//   NEW [fen]          -> OK <id>
+//   MOVE <id> <move>   -> OK <id> <state>          (move in SAN or UCI, state as in STATE)
+//   LEGAL <id>         -> OK <id> <san> <san> ...
+//   STATE <id>         -> OK <id> NORMAL|CHECK|CHECKMATE|DRAW
+//   FEN <id>           -> OK <id> <fen>
+//   END <id>           -> OK <id>
+// errors are "ERR <id> <reason>". Each game lives on one worker (id % workers), so requests of a
+// game are answered in order while different games are served in parallel. A game belongs to the connection
+// that created it: other connections get "unknown game", and it ends when that connection closes.
+
+class GameServer {
+    public:
+        GameServer(const string& path, uint32_t nworkers);
+        ~GameServer();
+        void run(); // accepts connections and serves requests until stop()
+        void stop();
+        size_t games(); // number of open games
+
+    private:
+        struct Connection {
+            int fd; // non-blocking, only the I/O thread reads and writes it
+            string inbuf; // bytes after the last complete request
+            mutex wlock; // guards outbuf and dead, workers queue responses that the I/O thread sends
+            string outbuf; // whole responses not sent yet
+            bool dead; // send failed or the client fell too far behind: the I/O thread drops the connection
+            atomic<bool> closing; // the client closed its end, queued requests are still answered
+            atomic<uint32_t> jobs; // requests queued on the workers
+            vector<unordered_set<uint64_t> > games; // ids of its open games by worker, each set only touched by its worker
+            Connection(int fd, uint32_t nworkers) : fd(fd), dead(false), closing(false), jobs(0), games(nworkers) {}
+            ~Connection();
+            bool queue(const string& response); // true if the I/O thread has to be woken up to send it
+            bool flush(); // sends what the socket takes without blocking, false once the connection is dead
+            bool pending(); // responses not sent yet
+        };
+        struct Session {
+            ChessInterface game;
+            const Connection* owner; // alive while the game is: closing the connection ends its games first
+        };
+
+        string path;
+        int listen_fd;
+        int wake_fds[2]; // pipe that interrupts poll() on stop() and when responses are queued
+        atomic<bool> running;
+        atomic<uint64_t> next_id;
+        atomic<size_t> ngames;
+        ThreadPool pool;
+        vector<unordered_map<uint64_t,Session*> > sessions; // per worker, only touched by that worker
+
+        void wake();
+        void dispatch(const shared_ptr<Connection>& conn, const string& request);
+        void process(uint32_t worker, Connection* conn, uint64_t id, const string& cmd, const string& args, string& response);
+        void end_games(const shared_ptr<Connection>& conn); // ends the games of a closed connection, after its queued requests
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include "chess_interface.h"
+#include "mcts.h"
+#include "pgn_writer.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+
+// plays engine A against engine B over a thread pool, one game per job, and writes PGN and a summary
+// match [--games N] [--threads N] [--openings fens.txt] [--a settings] [--b settings] [--pgn out.pgn]
+//       [--max-plies N] [--material N] [--material-plies N]
+// settings: comma-separated MCTSConfig fields, e.g. "name=uct,playouts=800,cpuct=1.4,puct=0,bias=0.5,nodes=100000"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+struct EngineSettings {
+    string name;
+    MCTSConfig cfg;
+};
+
+struct MatchRules {
+    uint32_t max_plies = 400; // drawn after this many plies
+    int32_t material = 9; // won when one side is this many pawns ahead...
+    uint32_t material_plies = 20; // ...for this many plies in a row (0 turns it off)
+};
+
+struct GameRecord {
+    uint8_t result; // WHITE_WINS, DRAWN, BLACK_WINS
+    bool a_white;
+    string termination;
+    string pgn;
+};
+
+static bool parse_settings(const string& str, EngineSettings& eng) {
+    stringstream ss(str);
+    string field;
+    while(getline(ss,field,',')) {
+        size_t eq = field.find('=');
+        if(eq==string::npos)
+            return false;
+        string key = field.substr(0,eq);
+        string val = field.substr(eq+1);
+        if(key=="name") eng.name = val;
+        else if(key=="playouts"&&atoll(val.c_str())>0) eng.cfg.playouts = atoll(val.c_str());
+        else if(key=="millis") eng.cfg.millis = atoi(val.c_str());
+        else if(key=="cpuct") eng.cfg.cpuct = atof(val.c_str());
+        else if(key=="puct") eng.cfg.puct = atoi(val.c_str())!=0;
+        else if(key=="bias") eng.cfg.capture_bias = atof(val.c_str());
+        else if(key=="maxplies") eng.cfg.max_plies = atoi(val.c_str());
+        else if(key=="nodes") eng.cfg.max_nodes = atoi(val.c_str());
+        else return false;
+    }
+    eng.cfg.threads = 1; // games run in parallel instead
+    if(eng.cfg.millis)
+        eng.cfg.playouts = UINT64_MAX;
+    return true;
+}
+
+static void play_game(uint32_t gnum, const string& fen, bool a_white, MCTS& a, MCTS& b,
+        const EngineSettings& sa, const EngineSettings& sb, const MatchRules& rules, GameRecord& rec) {
+    ChessInterface game;
+    game.set_state(ChessState(fen));
+    ChessState start = game;
+    MCTS& white = a_white ? a : b;
+    MCTS& black = a_white ? b : a;
+    white.reseed(2*gnum+1);
+    black.reseed(2*gnum+2);
+
+    vector<uint64_t> history; // hashes since the last capture or pawn move
+    history.push_back(game.hash());
+    vector<string> sans;
+    uint32_t ahead_plies = 0;
+    rec.a_white = a_white;
+    while(true) {
+        uint8_t state = game.get_state();
+        if(state==CHECKMATE) {
+            rec.result = (game.active==WT) ? BLACK_WINS : WHITE_WINS;
+            rec.termination = "checkmate";
+            break;
+        }
+        if(state==DRAW) {
+            rec.result = DRAWN;
+            rec.termination = "stalemate";
+            break;
+        }
+        if(game.hmove>=100) {
+            rec.result = DRAWN;
+            rec.termination = "fifty-move rule";
+            break;
+        }
+        if(insufficient_material(game)) {
+            rec.result = DRAWN;
+            rec.termination = "insufficient material";
+            break;
+        }
+        uint32_t repeats = 0;
+        for(uint64_t h: history)
+            repeats += (h==history.back());
+        if(repeats>=3) {
+            rec.result = DRAWN;
+            rec.termination = "repetition";
+            break;
+        }
+        int32_t balance = material_balance(game);
+        ahead_plies = (abs(balance)>=rules.material) ? ahead_plies+1 : 0;
+        if(rules.material_plies&&ahead_plies>=rules.material_plies) {
+            rec.result = (balance>0) ? WHITE_WINS : BLACK_WINS;
+            rec.termination = "material";
+            break;
+        }
+        if(sans.size()>=rules.max_plies) {
+            rec.result = DRAWN;
+            rec.termination = "move limit";
+            break;
+        }
+
+        minfo mv = ((game.active==WT) ? white : black).search(game);
+        sans.push_back(game.to_san(mv));
+        game.move(mv);
+        if(game.hmove==0)
+            history.clear();
+        history.push_back(game.hash());
+    }
+
+    const char* result = (rec.result==WHITE_WINS) ? "1-0" : (rec.result==BLACK_WINS) ? "0-1" : "1/2-1/2";
+    // the seven tag roster first: Event, Site, Date, Round, White, Black, Result
+    char date[16];
+    time_t now = time(NULL);
+    tm local;
+    strftime(date,sizeof(date),"%Y.%m.%d",localtime_r(&now,&local));
+    PGNWriter pgn;
+    pgn.tag("Event","match");
+    pgn.tag("Site","?");
+    pgn.tag("Date",date);
+    pgn.tag("Round",to_string(gnum+1).c_str());
+    pgn.tag("White",(a_white ? sa : sb).name.c_str());
+    pgn.tag("Black",(a_white ? sb : sa).name.c_str());
+    pgn.tag("Result",result);
+    if(fen!=START_FEN) {
+        pgn.tag("SetUp","1");
+        pgn.tag("FEN",fen.c_str());
+    }
+    pgn.tag("PlyCount",to_string(sans.size()).c_str());
+    pgn.tag("Termination",rec.termination.c_str());
+    pgn.start(start.fmove,start.active);
+    for(const string& san: sans)
+        pgn.move(san.c_str());
+    pgn.result(result);
+    rec.pgn = pgn.str();
+}
+
+static double elo(double score) {
+    score = min(max(score,1e-6),1-1e-6);
+    return -400*log10(1/score-1);
+}
+
+int main(int argc, char** argv) {
+    uint32_t ngames = 100;
+    uint32_t nthreads = thread::hardware_concurrency();
+    string openings_path, pgn_path = "match.pgn";
+    EngineSettings sa, sb;
+    sa.name = "A";
+    sb.name = "B";
+    sa.cfg.playouts = sb.cfg.playouts = 400;
+    MatchRules rules;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        bool ok = (i+1<argc);
+        if(!ok) {}
+        else if(opt=="--games") {
+            ngames = max(atoi(argv[++i]),0);
+            ok = ngames>=1; // the score divides by it
+        }
+        else if(opt=="--threads") nthreads = atoi(argv[++i]);
+        else if(opt=="--openings") openings_path = argv[++i];
+        else if(opt=="--pgn") pgn_path = argv[++i];
+        else if(opt=="--a") ok = parse_settings(argv[++i],sa);
+        else if(opt=="--b") ok = parse_settings(argv[++i],sb);
+        else if(opt=="--max-plies") rules.max_plies = atoi(argv[++i]);
+        else if(opt=="--material") rules.material = atoi(argv[++i]);
+        else if(opt=="--material-plies") rules.material_plies = atoi(argv[++i]);
+        else ok = false;
+        if(!ok) {
+            cerr << "usage: " << argv[0] << " [--games N] [--threads N] [--openings fens.txt] [--a settings] [--b settings]"
+                << " [--pgn out.pgn] [--max-plies N] [--material N] [--material-plies N]" << endl;
+            return 1;
+        }
+    }
+    sa.cfg.threads = sb.cfg.threads = 1;
+    if(sa.cfg.max_nodes==MCTSConfig().max_nodes) // the default arena is sized for one big search
+        sa.cfg.max_nodes = min<uint64_t>(sa.cfg.max_nodes,sa.cfg.playouts*64);
+    if(sb.cfg.max_nodes==MCTSConfig().max_nodes)
+        sb.cfg.max_nodes = min<uint64_t>(sb.cfg.max_nodes,sb.cfg.playouts*64);
+
+    // every opening is played twice, with colors swapped
+    vector<string> openings;
+    if(!openings_path.empty()) {
+        ifstream fin(openings_path);
+        if(!fin) {
+            cerr << "cannot open " << openings_path << endl;
+            return 1;
+        }
+        string line;
+        while(getline(fin,line)) {
+            if(line.empty()||line[0]=='#')
+                continue;
+            try {
+                ChessState check(line);
+            } catch(const invalid_argument& e) {
+                cerr << e.what() << endl;
+                return 1;
+            }
+            openings.push_back(line);
+        }
+    }
+    if(openings.empty())
+        openings.push_back(START_FEN);
+
+    vector<GameRecord> records(ngames);
+    auto stime = chrono::steady_clock::now();
+    {
+        ThreadPool pool(nthreads);
+        // engines are created once per worker and reused by all of its games
+        vector<pair<MCTS*,MCTS*> > engines(pool.size(),pair<MCTS*,MCTS*>(NULL,NULL));
+        for(uint32_t g=0; g<ngames; g++) {
+            uint32_t worker = g%pool.size();
+            pool.submit(worker,[&,g,worker]() {
+                if(engines[worker].first==NULL)
+                    engines[worker] = make_pair(new MCTS(sa.cfg),new MCTS(sb.cfg));
+                const string& fen = openings[(g/2)%openings.size()];
+                play_game(g,fen,g%2==0,*engines[worker].first,*engines[worker].second,sa,sb,rules,records[g]);
+            });
+        }
+        pool.wait();
+        for(auto& eng: engines) {
+            delete eng.first;
+            delete eng.second;
+        }
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+
+    ofstream fout(pgn_path);
+    uint32_t wins = 0, draws = 0, losses = 0; // for A
+    map<string,uint32_t> terminations;
+    for(const GameRecord& rec: records) {
+        fout << rec.pgn;
+        terminations[rec.termination]++;
+        if(rec.result==DRAWN)
+            draws++;
+        else if((rec.result==WHITE_WINS)==rec.a_white)
+            wins++;
+        else
+            losses++;
+    }
+
+    // Elo difference of A over B, with a 95% interval from the spread of the game scores
+    double n = ngames;
+    double score = (wins+0.5*draws)/n;
+    double var = (wins*pow(1-score,2)+draws*pow(0.5-score,2)+losses*pow(score,2))/n;
+    double margin = 1.96*sqrt(var/n);
+    cout << sa.name << " vs " << sb.name << ": +" << wins << " =" << draws << " -" << losses
+        << " (" << fixed << setprecision(1) << 100*score << "%)" << endl;
+    cout << "Elo " << elo(score) << " [" << elo(score-margin) << ", " << elo(score+margin) << "]" << endl;
+    for(auto& it: terminations)
+        cout << it.first << ": " << it.second << endl;
+    cout << ngames << " games in " << secs << "s (" << ngames/secs << " games/s)" << endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "chess_interface.h"
+#include "mate_solver.h"
+#include <chrono>
+#include <cstdlib>
+
+// proves or refutes forced mates with df-pn:
+// mate [--moves N] [--nodes N] [--tt BITS] [--checks] [--exact] [FEN]
+// --exact finds the shortest mate and the longest defence instead of any mate within N moves
+// without a FEN, reads one FEN per line from stdin (puzzle collections, see puzzles/) and prints one result per line,
+// then the totals: mate < puzzles/mates.fen is the solver benchmark
+
+static void print_result(const string& fen, const MateResult& res, bool exact, double secs) {
+    if(res.status==MATE_FOUND) {
+        ChessInterface game;
+        game.set_state(ChessState(fen));
+        cout << (res.exact ? "mate in " : "mate within ") << res.moves << ":";
+        for(minfo mv: res.line) {
+            cout << " " << game.to_san(mv);
+            game.move(mv);
+        }
+        if(!res.complete)
+            cout << " ... (line cut short by the node limit)";
+        else if(exact&&!res.exact)
+            cout << " (exact length not found within the node limit)";
+    } else
+        cout << ((res.status==MATE_NONE) ? "no mate" : "unknown (node limit)");
+    cout << " (" << res.nodes << " nodes, " << secs << "s)" << endl;
+}
+
+int main(int argc, char** argv) {
+    uint32_t max_moves = 10;
+    uint64_t max_nodes = 50000000;
+    uint32_t tt_bits = 22;
+    bool checks_only = false;
+    bool exact = false;
+    string fen;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--moves"&&i+1<argc) max_moves = atoi(argv[++i]);
+        else if(opt=="--nodes"&&i+1<argc) max_nodes = atoll(argv[++i]);
+        else if(opt=="--tt"&&i+1<argc) tt_bits = atoi(argv[++i]);
+        else if(opt=="--checks") checks_only = true;
+        else if(opt=="--exact") exact = true;
+        else if(opt[0]=='-') {
+            cerr << "usage: " << argv[0] << " [--moves N] [--nodes N] [--tt BITS] [--checks] [--exact] [FEN]" << endl;
+            return 1;
+        } else
+            fen = opt;
+    }
+    MateSolver solver(tt_bits,max_nodes,checks_only);
+    vector<string> fens;
+    if(!fen.empty())
+        fens.push_back(fen);
+    else {
+        string line;
+        while(getline(cin,line))
+            if(!line.empty()&&line[0]!='#')
+                fens.push_back(line);
+    }
+    uint32_t counts[3] = {0,0,0}; // by status
+    uint64_t nodes = 0;
+    double total = 0;
+    for(const string& f: fens) {
+        try {
+            ChessState pos(f);
+            auto stime = chrono::steady_clock::now();
+            MateResult res = solver.solve(pos,max_moves,exact);
+            double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+            print_result(f,res,exact,secs);
+            counts[res.status]++;
+            nodes += res.nodes;
+            total += secs;
+        } catch(const invalid_argument& e) {
+            cout << e.what() << endl;
+        }
+    }
+    if(fens.size()>1)
+        cout << fens.size() << " positions: " << counts[MATE_FOUND] << " mates, " << counts[MATE_NONE] << " no mate, "
+            << counts[MATE_UNKNOWN] << " unknown, " << nodes << " nodes, " << total << "s" << endl;
+    return 0;
+}
@@ -0,0 +1,267 @@
+#include "mate_solver.h"
+
+#define PN_INF 1000000000U // proof/disproof number of a decided node
+#define NO_PLIES UINT8_MAX // ResultEntry::mates of positions without a known mate
+
+static uint32_t sat_add(uint32_t a, uint32_t b) {
+    return (uint64_t)a+b>=PN_INF ? PN_INF : a+b;
+}
+
+MateSolver::MateSolver(uint32_t tt_bits, uint64_t max_nodes, bool checks_only)
+    : tt(1ULL<<tt_bits), results(1ULL<<tt_bits), max_nodes(max_nodes), checks_only(checks_only), attacker(WT), nodes(0) {
+    for(ResultEntry& ent: results) {
+        ent.key = 0;
+        ent.mates = NO_PLIES;
+        ent.holds = -1;
+    }
+}
+
+uint64_t MateSolver::key(const ChessState& pos) const {
+    // entries stay valid across solves: the key includes the attacker
+    return pos.hash()^(attacker==WT ? 0 : 0xD1B54A32D192ED03ULL);
+}
+
+void MateSolver::moves(ChessState& pos, uint8_t plies, vector<minfo>& list) {
+    list.clear();
+    pos.all_legal_moves(list);
+    if(pos.active!=attacker||!(checks_only||plies==1)) // a mate in one is a check
+        return;
+    uint8_t ksq = *pos.psquares[(attacker==WT) ? BK : WK].begin();
+    size_t n = 0;
+    for(minfo mv: list) {
+        ChessState child = pos;
+        child.execute_move(mv);
+        if(child.is_checking(attacker,ksq))
+            list[n++] = mv;
+    }
+    list.resize(n);
+}
+
+void MateSolver::leaf(ChessState& pos, uint8_t plies, uint32_t& phi, uint32_t& delta) {
+    // phi==0: the side to move reaches its goal (mates, or holds out), delta==0: it fails
+    bool or_node = pos.active==attacker;
+    if(or_node&&plies==0) {
+        phi = PN_INF;
+        delta = 0;
+        return;
+    }
+    moves(pos,plies,leaf_list);
+    if(leaf_list.empty()) {
+        bool mated = !or_node&&pos.is_checking(attacker,*pos.psquares[(attacker==WT) ? BK : WK].begin());
+        phi = (or_node||mated) ? PN_INF : 0; // stalemate holds for the defender
+        delta = (or_node||mated) ? 0 : PN_INF;
+    } else if(plies==0) { // the defender survived
+        phi = 0;
+        delta = PN_INF;
+    } else {
+        phi = 1;
+        delta = leaf_list.size(); // many moves: hard to refute
+    }
+}
+
+bool MateSolver::probe(uint64_t pos_key, uint8_t plies, bool or_node, uint32_t& phi, uint32_t& delta) const {
+    const ResultEntry& res = results[pos_key&(results.size()-1)];
+    if(res.key==pos_key&&(plies>=res.mates||plies<=res.holds)) { // decided, possibly by a search with other plies
+        bool wins = plies>=res.mates;
+        phi = (wins==or_node) ? 0 : PN_INF;
+        delta = (wins==or_node) ? PN_INF : 0;
+        return true;
+    }
+    uint64_t k = key(pos_key,plies);
+    const TTEntry* bucket = &tt[k&(tt.size()-2)];
+    for(int i=0; i<2; i++) {
+        if(bucket[i].key==k) {
+            phi = bucket[i].phi;
+            delta = bucket[i].delta;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MateSolver::lookup(ChessState& pos, uint64_t pos_key, uint8_t plies, uint32_t& phi, uint32_t& delta) {
+    bool or_node = pos.active==attacker;
+    if(!probe(pos_key,plies,or_node,phi,delta)) {
+        leaf(pos,plies,phi,delta);
+        store(pos_key,plies,or_node,phi,delta,false);
+    }
+}
+
+void MateSolver::store(uint64_t pos_key, uint8_t plies, bool or_node, uint32_t phi, uint32_t delta, bool expanded) {
+    bool mates = (or_node ? phi : delta)==0;
+    bool holds = (or_node ? delta : phi)==0;
+    if(mates||holds) {
+        ResultEntry& res = results[pos_key&(results.size()-1)];
+        if(res.key!=pos_key) {
+            res.key = pos_key;
+            res.mates = NO_PLIES;
+            res.holds = -1;
+        }
+        if(mates)
+            res.mates = min(res.mates,plies);
+        else
+            res.holds = max<int16_t>(res.holds,plies);
+        return;
+    }
+    uint64_t k = key(pos_key,plies);
+    TTEntry* bucket = &tt[k&(tt.size()-2)];
+    if(expanded&&bucket[1].key==k) // the leaf entry is outdated
+        bucket[1].key = 0;
+    TTEntry& ent = bucket[expanded ? 0 : 1];
+    ent.key = k;
+    ent.phi = phi;
+    ent.delta = delta;
+}
+
+void MateSolver::mid(ChessState& pos, uint8_t plies, uint32_t thphi, uint32_t thdelta) {
+    // multiple iterative deepening: expand the most proving child until pos exceeds its thresholds
+    nodes++;
+    vector<minfo>& list = lists[plies];
+    vector<Child>& kids = children[plies];
+    moves(pos,plies,list);
+    kids.resize(list.size());
+    bool or_node = pos.active==attacker;
+    for(size_t i=0; i<list.size(); i++) {
+        Child& kid = kids[i];
+        kid.pos = pos;
+        kid.pos.execute_move(list[i]);
+        kid.key = key(kid.pos);
+        lookup(kid.pos,kid.key,plies-1,kid.phi,kid.delta);
+    }
+    uint64_t pk = key(pos);
+    while(true) {
+        uint32_t phi = PN_INF, delta = 0, delta2 = PN_INF, best_phi = 0;
+        size_t best = 0;
+        for(size_t i=0; i<kids.size(); i++) {
+            Child& kid = kids[i];
+            if(kid.phi&&kid.delta) // decided children stay decided
+                probe(kid.key,plies-1,!or_node,kid.phi,kid.delta);
+            uint32_t cphi = kid.phi, cdelta = kid.delta;
+            delta = sat_add(delta,cphi);
+            if(cdelta<phi) {
+                delta2 = phi;
+                phi = cdelta;
+                best = i;
+                best_phi = cphi;
+            } else if(cdelta<delta2)
+                delta2 = cdelta;
+        }
+        if(phi==0||delta==0||phi>=thphi||delta>=thdelta||nodes>=max_nodes) {
+            store(pk,plies,or_node,phi,delta,true);
+            return;
+        }
+        // 1+epsilon trick: let the child run past the second best by a quarter, fewer switches between siblings
+        uint32_t cthphi = (thdelta>=PN_INF) ? PN_INF : thdelta+best_phi-delta;
+        uint32_t cthdelta = min<uint64_t>(thphi,(uint64_t)delta2+delta2/4+1);
+        mid(kids[best].pos,plies-1,cthphi,cthdelta);
+    }
+}
+
+bool MateSolver::prove(ChessState& pos, uint8_t plies) {
+    uint32_t phi, delta;
+    lookup(pos,key(pos),plies,phi,delta);
+    if(phi&&delta) {
+        mid(pos,plies,PN_INF,PN_INF);
+        lookup(pos,key(pos),plies,phi,delta);
+    }
+    return (pos.active==attacker) ? phi==0 : delta==0;
+}
+
+uint32_t MateSolver::shortest(ChessState& pos, uint8_t plies) {
+    for(uint32_t k=1; 2*k-1<=plies; k++) {
+        if(prove(pos,2*k-1))
+            return k;
+        if(nodes>=max_nodes) // not disproven, only given up
+            return 0;
+    }
+    return 0;
+}
+
+MateResult MateSolver::solve(const ChessState& pos, uint32_t max_moves, bool exact) {
+    MateResult res;
+    res.status = MATE_NONE;
+    res.moves = 0;
+    res.exact = false;
+    res.complete = false;
+    attacker = pos.active;
+    nodes = 0;
+    ChessState root = pos;
+    max_moves = min(max_moves,(uint32_t)(NO_PLIES-1)/2); // plies stay below NO_PLIES
+    lists.resize(2*max_moves);
+    children.resize(2*max_moves);
+    if(max_moves==0||!prove(root,2*max_moves-1)) {
+        res.status = (nodes>=max_nodes) ? MATE_UNKNOWN : MATE_NONE;
+        res.nodes = nodes;
+        return res;
+    }
+    res.status = MATE_FOUND;
+    res.moves = max_moves;
+    if(exact) {
+        uint32_t k = shortest(root,2*max_moves-1);
+        if(k) // 0: the node limit came first, the line below is then any mate within max_moves
+            res.moves = k;
+        exact = k!=0;
+    }
+    res.exact = exact;
+
+    // without exact, the attacker plays any proven move and the defender avoids a mate in one when it can
+    ChessState cur = root;
+    uint8_t plies = 2*res.moves-1;
+    vector<minfo> list;
+    uint32_t phi, delta;
+    while(true) {
+        moves(cur,plies,list);
+        minfo choice;
+        uint8_t next = plies-1;
+        bool found = false;
+        for(uint8_t p=exact ? 0 : plies-1; p<plies&&!found; p+=2) {
+            // children already proven in the table first, proving a child that fails means a full disproof
+            for(uint8_t pass=0; pass<2&&!found; pass++) {
+                for(minfo mv: list) {
+                    ChessState child = cur;
+                    child.execute_move(mv);
+                    if(pass==0) {
+                        lookup(child,key(child),p,phi,delta);
+                        found = delta==0;
+                    } else
+                        found = prove(child,p);
+                    if(found) {
+                        choice = mv;
+                        next = p;
+                        break;
+                    }
+                }
+            }
+        }
+        if(!found) // the node limit stopped the proof of every move: the line is incomplete
+            break;
+        res.line.push_back(choice);
+        cur.execute_move(choice);
+        moves(cur,next,list);
+        if(list.empty()||next==0) {
+            res.complete = true;
+            break;
+        }
+        uint32_t longest = 0;
+        for(minfo mv: list) {
+            ChessState child = cur;
+            child.execute_move(mv);
+            uint32_t k = exact ? shortest(child,next-1) : (next>2&&prove(child,1)) ? 1 : (next/2);
+            if(k==0) { // unresolved within the node limit
+                longest = 0;
+                break;
+            }
+            if(k>longest) {
+                longest = k;
+                choice = mv;
+            }
+        }
+        if(longest==0)
+            break;
+        res.line.push_back(choice);
+        cur.execute_move(choice);
+        plies = 2*longest-1;
+    }
+    res.nodes = nodes;
+    return res;
+}
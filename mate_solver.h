@@ -0,0 +1,71 @@
+#ifndef MATE_SOLVER_H
+#define MATE_SOLVER_H
+#include "chess_state.h"
+
+// depth-first proof-number search (df-pn) for forced mates of the side to move within a number of moves
+// proof and disproof numbers are kept in a hash table keyed by position and remaining plies, two entries per bucket: one
+// for an expanded node and one for a leaf, so that the many leaves never push expanded nodes out. Results are in a second one
+// keyed by position alone: the fewest plies the attacker is known to mate within and the most plies the defender is
+// known to hold out answer every other number of plies (a mate within n is a mate within n+1)
+
+#define MATE_FOUND 0
+#define MATE_NONE 1 // disproven: no mate within the limit
+#define MATE_UNKNOWN 2 // the node limit was reached first
+
+struct MateResult {
+    uint8_t status;
+    uint32_t moves; // when MATE_FOUND: max_moves, or the exact mate length with exact
+    bool exact; // moves is the exact mate length (false if the node limit was reached before it was found)
+    vector<minfo> line; // a mating line, the fastest mate against the longest defence with exact
+    bool complete; // the line ends in mate, false if the node limit cut it short
+    uint64_t nodes;
+};
+
+class MateSolver {
+    public:
+        MateSolver(uint32_t tt_bits=20, uint64_t max_nodes=50000000, bool checks_only=false);
+        // proves or disproves a mate within max_moves, exact also finds the exact mate length (disproving every shorter
+        // mate, which costs much more than the proof in quiet positions)
+        MateResult solve(const ChessState& pos, uint32_t max_moves, bool exact=false);
+
+    private:
+        struct TTEntry {
+            uint64_t key;
+            uint32_t phi; // proof number for the side to move (0: it reaches its goal)
+            uint32_t delta; // disproof number for the side to move (0: it fails)
+        };
+        struct ResultEntry {
+            uint64_t key;
+            uint8_t mates; // fewest plies the attacker is known to mate within, NO_PLIES if none
+            int16_t holds; // most plies the defender is known to hold out, -1 if none
+        };
+        vector<TTEntry> tt;
+        vector<ResultEntry> results;
+        uint64_t max_nodes;
+        bool checks_only; // the attacker only considers checking moves
+        bool attacker;
+        uint64_t nodes;
+        struct Child {
+            ChessState pos;
+            uint64_t key;
+            uint32_t phi, delta; // last known numbers, kept when the table entry is overwritten (else siblings that share
+                                 // an entry could push each other out forever)
+        };
+        // scratch, by remaining plies so that the recursion in mid does not allocate
+        vector<vector<minfo> > lists;
+        vector<vector<Child> > children;
+        vector<minfo> leaf_list;
+
+        uint64_t key(const ChessState& pos) const;
+        uint64_t key(uint64_t pos_key, uint8_t plies) const { return pos_key^((plies+1)*0x9E3779B97F4A7C15ULL); }
+        void moves(ChessState& pos, uint8_t plies, vector<minfo>& list); // candidate moves of the side to move
+        void leaf(ChessState& pos, uint8_t plies, uint32_t& phi, uint32_t& delta);
+        bool probe(uint64_t pos_key, uint8_t plies, bool or_node, uint32_t& phi, uint32_t& delta) const; // false if not stored
+        void lookup(ChessState& pos, uint64_t pos_key, uint8_t plies, uint32_t& phi, uint32_t& delta); // probe, or leaf and store
+        void store(uint64_t pos_key, uint8_t plies, bool or_node, uint32_t phi, uint32_t delta, bool expanded);
+        void mid(ChessState& pos, uint8_t plies, uint32_t thphi, uint32_t thdelta);
+        bool prove(ChessState& pos, uint8_t plies); // does the attacker win from pos within plies?
+        uint32_t shortest(ChessState& pos, uint8_t plies); // fewest attacker moves to mate from pos, 0 if none within plies
+};
+
+#endif
@@ -0,0 +1,337 @@
+#include "mcts.h"
+#include <thread>
+#include <chrono>
+#include <cmath>
+
+static const int32_t piece_value[INV] = {[EMP]=0,
+                                [WP]=1,
+                                [WN]=3,
+                                [WB]=3,
+                                [WR]=5,
+                                [WQ]=9,
+                                [WK]=0,
+                                [BP]=1,
+                                [BN]=3,
+                                [BB]=3,
+                                [BR]=5,
+                                [BQ]=9,
+                                [BK]=0};
+
+int32_t material_balance(const ChessState& pos) {
+    int32_t balance = 0;
+    for(uint8_t p=WP; p<WK; p++)
+        balance += piece_value[p]*(pos.psquares[p].size()-pos.psquares[p+WK].size());
+    return balance;
+}
+
+bool insufficient_material(const ChessState& pos) {
+    // no pawns, rooks or queens, and at most one minor piece on the board
+    for(uint8_t p: {WP,WR,WQ,BP,BR,BQ}) {
+        if(!pos.psquares[p].empty())
+            return false;
+    }
+    return pos.psquares[WN].size()+pos.psquares[WB].size()+pos.psquares[BN].size()+pos.psquares[BB].size()<=1;
+}
+
+static int32_t victim_value(const ChessState& pos, minfo mv) {
+    // value of the captured piece plus the gain of a promotion, 0 for quiet moves
+    uint8_t p1 = pos.board[mv.sq1/SZ][mv.sq1%SZ];
+    uint8_t p2 = pos.board[mv.sq2/SZ][mv.sq2%SZ];
+    int32_t value = piece_value[p2]+piece_value[mv.newp]-piece_value[p1];
+    if((p1==WP||p1==BP)&&mv.sq2==pos.enpassant)
+        value += 1;
+    return value;
+}
+
+MCTS::MCTS(const MCTSConfig& cfg) : cfg(cfg), used(0), done(0), stopping(false), ponder_hit(false), limit(0), deadline(0) {
+    if(this->cfg.max_nodes<MAX_MOVES+1)
+        this->cfg.max_nodes = MAX_MOVES+1;
+    if(this->cfg.threads==0)
+        this->cfg.threads = 1;
+    if(this->cfg.playouts==0) // a search always has a move to return
+        this->cfg.playouts = 1;
+    arena = new MCTSNode[this->cfg.max_nodes];
+}
+
+MCTS::~MCTS() {
+    delete[] arena;
+}
+
+const MCTSConfig& MCTS::config() const {
+    return cfg;
+}
+
+void MCTS::reseed(uint64_t seed) {
+    cfg.seed = seed;
+}
+
+uint64_t MCTS::playouts() const {
+    return done;
+}
+
+uint32_t MCTS::nodes() const {
+    return used;
+}
+
+void MCTS::stop() {
+    stopping = true;
+}
+
+void MCTS::ponderhit() {
+    // sticky: a search that has not set up its limits yet sees the flag and applies them itself
+    ponder_hit = true;
+    apply_limits();
+}
+
+void MCTS::apply_limits() {
+    deadline = cfg.millis ? (chrono::steady_clock::now()+chrono::milliseconds(cfg.millis)).time_since_epoch().count() : 0;
+    limit = cfg.playouts;
+}
+
+void MCTS::init(uint32_t idx, minfo mv, float prior) {
+    MCTSNode& node = arena[idx];
+    node.mv = mv;
+    node.prior = prior;
+    node.first_child = 0;
+    node.nchildren = 0;
+    node.terminal = DRAWN;
+    node.visits.store(0,memory_order_relaxed);
+    node.score.store(0,memory_order_relaxed);
+    node.state.store(NODE_LEAF,memory_order_relaxed);
+}
+
+uint32_t MCTS::alloc(uint32_t n) {
+    uint32_t idx = used.fetch_add(n);
+    if(idx+n>cfg.max_nodes)
+        return 0; // full: the rest of the arena stays unused for this search
+    return idx;
+}
+
+bool MCTS::expand(uint32_t idx, ChessState& pos, ChessState& backup, vector<minfo>& moves) {
+    // called by the thread that moved the node from NODE_LEAF to NODE_EXPANDING
+    MCTSNode& node = arena[idx];
+    if(idx!=0&&(pos.hmove>=100||insufficient_material(pos))) { // the root is searched regardless
+        node.terminal = DRAWN;
+        node.state.store(NODE_TERMINAL,memory_order_release);
+        return false;
+    }
+    if(used+MAX_MOVES>cfg.max_nodes) { // arena full, stay a leaf
+        node.state.store(NODE_LEAF,memory_order_release);
+        return false;
+    }
+    moves.clear();
+    pos.all_legal_moves(moves,&backup);
+    if(moves.empty()) {
+        if(pos.get_state(&backup)==CHECKMATE)
+            node.terminal = (pos.active==WT) ? BLACK_WINS : WHITE_WINS;
+        else
+            node.terminal = DRAWN;
+        node.state.store(NODE_TERMINAL,memory_order_release);
+        return false;
+    }
+    uint32_t first = alloc(moves.size());
+    if(first==0) {
+        node.state.store(NODE_LEAF,memory_order_release);
+        return false;
+    }
+
+    // priors: uniform, plus the value won by captures and promotions
+    float total = 0;
+    for(minfo mv: moves)
+        total += 1+max(victim_value(pos,mv),0);
+    for(size_t i=0; i<moves.size(); i++)
+        init(first+i,moves[i],(1+max(victim_value(pos,moves[i]),0))/total);
+
+    node.first_child = first;
+    node.nchildren = moves.size();
+    node.state.store(NODE_EXPANDED,memory_order_release);
+    return true;
+}
+
+uint32_t MCTS::select(const MCTSNode& node) {
+    int32_t nvisits = max(node.visits.load(memory_order_relaxed),1);
+    float lnn = log((float)nvisits);
+    float sqrtn = sqrt((float)nvisits);
+    uint32_t best = node.first_child;
+    float best_score = -1;
+    for(uint32_t idx=node.first_child; idx<node.first_child+node.nchildren; idx++) {
+        const MCTSNode& child = arena[idx];
+        int32_t n = child.visits.load(memory_order_relaxed);
+        float q = (n>0) ? child.score.load(memory_order_relaxed)/(2.0f*n) : 0.5f;
+        float score;
+        if(cfg.puct)
+            score = q+cfg.cpuct*child.prior*sqrtn/(1+n);
+        else if(n==0) // UCT tries every child once, likely captures first
+            score = 1e6f+child.prior;
+        else
+            score = q+cfg.cpuct*sqrt(lnn/n);
+        if(score>best_score) {
+            best_score = score;
+            best = idx;
+        }
+    }
+    return best;
+}
+
+uint8_t MCTS::playout(ChessState& pos, ChessState& backup, vector<minfo>& moves, mt19937_64& rng) {
+    // plays random moves (or the best capture, with probability capture_bias) until the game ends
+    uniform_real_distribution<float> coin(0,1);
+    for(uint32_t ply=0; ; ply++) {
+        if(pos.hmove>=100||insufficient_material(pos))
+            return DRAWN;
+        if(ply>=cfg.max_plies) {
+            int32_t balance = material_balance(pos);
+            return (balance>=3) ? WHITE_WINS : (balance<=-3) ? BLACK_WINS : DRAWN;
+        }
+        moves.clear();
+        pos.all_legal_moves(moves,&backup);
+        if(moves.empty()) {
+            if(pos.get_state(&backup)==CHECKMATE)
+                return (pos.active==WT) ? BLACK_WINS : WHITE_WINS;
+            return DRAWN;
+        }
+
+        minfo mv = moves[rng()%moves.size()];
+        if(cfg.capture_bias>0&&coin(rng)<cfg.capture_bias) {
+            int32_t best = 0;
+            for(minfo cand: moves) {
+                int32_t value = victim_value(pos,cand);
+                if(value>best) {
+                    best = value;
+                    mv = cand;
+                }
+            }
+        }
+        pos.execute_move(mv);
+        backup.execute_move(mv);
+    }
+}
+
+void MCTS::worker(uint32_t id) {
+    mt19937_64 rng(cfg.seed+id*0x9E3779B97F4A7C15ULL);
+    ChessState pos;
+    ChessState backup;
+    vector<minfo> moves;
+    vector<uint32_t> path;
+    moves.reserve(MAX_MOVES);
+    path.reserve(256);
+    int32_t vloss = cfg.virtual_loss;
+
+    while(!stopping&&done<limit) {
+        int64_t until = deadline.load(memory_order_relaxed);
+        if(until&&chrono::steady_clock::now().time_since_epoch().count()>=until)
+            break;
+        pos = root;
+        backup = root;
+        path.clear();
+        path.push_back(0);
+        arena[0].visits += vloss;
+
+        // selection and expansion
+        uint8_t result;
+        uint32_t idx = 0;
+        while(true) {
+            MCTSNode& node = arena[idx];
+            uint8_t state = node.state.load(memory_order_acquire);
+            // a leaf is expanded on its second visit (the root on its first)
+            if(state==NODE_LEAF&&(idx==0||node.visits.load(memory_order_relaxed)>vloss)) {
+                uint8_t expected = NODE_LEAF;
+                if(node.state.compare_exchange_strong(expected,NODE_EXPANDING))
+                    expand(idx,pos,backup,moves);
+                state = node.state.load(memory_order_acquire);
+            }
+            if(state==NODE_TERMINAL) {
+                result = node.terminal;
+                break;
+            }
+            if(state!=NODE_EXPANDED) { // leaf, or another thread is expanding it
+                result = playout(pos,backup,moves,rng);
+                break;
+            }
+            idx = select(node);
+            arena[idx].visits += vloss;
+            pos.execute_move(arena[idx].mv);
+            backup.execute_move(arena[idx].mv);
+            path.push_back(idx);
+        }
+
+        // backpropagation: nodes at odd depths were entered by the root's side to move
+        for(size_t d=0; d<path.size(); d++) {
+            MCTSNode& node = arena[path[d]];
+            bool mover = (d%2==1) ? root.active : NEXT(root.active);
+            node.score += (mover==WT) ? result : WHITE_WINS-result;
+            node.visits += 1-vloss;
+        }
+        done++;
+    }
+}
+
+minfo MCTS::search(const ChessState& root, bool ponder) {
+    this->root = root;
+    used = 1;
+    done = 0;
+    if(ponder) {
+        limit = UINT64_MAX;
+        deadline = 0;
+    }
+    if(!ponder||ponder_hit) // the ponderhit may have come before the limits above
+        apply_limits();
+    minfo none = {0,0,EMP,INV_CAST};
+    init(0,none,1);
+
+    vector<thread> threads;
+    for(uint32_t id=1; id<cfg.threads; id++)
+        threads.push_back(thread(&MCTS::worker,this,id));
+    worker(0);
+    for(thread& th: threads)
+        th.join();
+    stopping = false; // cleared here rather than at the start, so that a stop() racing with the start is not lost
+    ponder_hit = false; // same for a ponderhit()
+
+    const MCTSNode& node = arena[0];
+    if(node.state.load()!=NODE_EXPANDED)
+        return none;
+    uint32_t best = node.first_child;
+    for(uint32_t idx=node.first_child; idx<node.first_child+node.nchildren; idx++) {
+        if(arena[idx].visits>arena[best].visits)
+            best = idx;
+    }
+    return arena[best].mv;
+}
+
+minfo MCTS::expected_reply() const {
+    minfo none = {0,0,EMP,INV_CAST};
+    const MCTSNode& node = arena[0];
+    if(node.state.load()!=NODE_EXPANDED)
+        return none;
+    uint32_t best = node.first_child;
+    for(uint32_t idx=node.first_child; idx<node.first_child+node.nchildren; idx++) {
+        if(arena[idx].visits>arena[best].visits)
+            best = idx;
+    }
+    const MCTSNode& child = arena[best];
+    if(child.state.load()!=NODE_EXPANDED)
+        return none;
+    uint32_t reply = child.first_child;
+    for(uint32_t idx=child.first_child; idx<child.first_child+child.nchildren; idx++) {
+        if(arena[idx].visits>arena[reply].visits)
+            reply = idx;
+    }
+    return arena[reply].mv;
+}
+
+float MCTS::value() const {
+    // score of the most visited root move, for the side to move at the root
+    const MCTSNode& node = arena[0];
+    if(node.state.load()==NODE_TERMINAL)
+        return (node.terminal==DRAWN) ? 0.5f : 0.0f; // no legal moves: mated or stalemated
+    if(node.state.load()!=NODE_EXPANDED)
+        return 0.5f;
+    uint32_t best = node.first_child;
+    for(uint32_t idx=node.first_child; idx<node.first_child+node.nchildren; idx++) {
+        if(arena[idx].visits>arena[best].visits)
+            best = idx;
+    }
+    int32_t n = arena[best].visits;
+    return (n>0) ? arena[best].score/(2.0f*n) : 0.5f;
+}
@@ -0,0 +1,76 @@
+#ifndef MCTS_H
+#define MCTS_H
+#include "chess_state.h"
+#include <atomic>
+#include <random>
+#include <cstdint>
+
+int32_t material_balance(const ChessState& pos); // white minus black, in pawns (N=B=3, R=5, Q=9)
+bool insufficient_material(const ChessState& pos); // K vs K, K+minor vs K
+
+struct MCTSConfig { // engine settings
+    uint32_t threads = 1;
+    uint64_t playouts = 10000; // per search
+    uint32_t millis = 0; // time limit per search, 0 for none
+    float cpuct = 1.4; // exploration constant
+    bool puct = false; // PUCT with capture-biased priors instead of UCT
+    float capture_bias = 0.5; // probability that a playout move is the best capture, when there is one
+    uint32_t max_plies = 200; // playout length before the game is adjudicated on material
+    int32_t virtual_loss = 3; // visits added to a path while a thread is playing it out
+    uint32_t max_nodes = 1<<22; // arena size, the tree stops growing when it is full
+    uint64_t seed = 1;
+};
+
+struct MCTSNode {
+    minfo mv; // move into this node
+    float prior;
+    uint32_t first_child; // index of the children in the arena, valid once expanded
+    uint16_t nchildren;
+    atomic<uint8_t> state; // NODE_LEAF, NODE_EXPANDING, NODE_EXPANDED or NODE_TERMINAL
+    uint8_t terminal; // WHITE_WINS, DRAWN, BLACK_WINS for terminal nodes
+    atomic<int32_t> visits; // includes virtual losses of threads below this node
+    atomic<int64_t> score; // sum of results in half points (0,1,2) for the player who made mv
+};
+
+#define NODE_LEAF 0
+#define NODE_EXPANDING 1
+#define NODE_EXPANDED 2
+#define NODE_TERMINAL 3
+
+class MCTS { // Monte Carlo tree search with random playouts, tree-parallel over cfg.threads
+    public:
+        MCTS(const MCTSConfig& cfg);
+        ~MCTS();
+        minfo search(const ChessState& root, bool ponder=false); // most visited root move, castle==INV_CAST if there is none
+        void stop(); // makes a running search return early (from another thread), or the next one return at once
+        void ponderhit(); // a search started with ponder=true (no limits) gets the configured limits from now on
+        minfo expected_reply() const; // most visited reply to the last search's move, castle==INV_CAST if there is none
+        float value() const; // expected score of the last search for the side to move, in [0,1]
+        uint64_t playouts() const; // playouts of the last search
+        uint32_t nodes() const; // arena nodes in use
+        const MCTSConfig& config() const;
+        void reseed(uint64_t seed); // playouts of later searches use another random sequence
+
+    private:
+        MCTSConfig cfg;
+        MCTSNode* arena; // fixed-size node pool, reset by every search
+        atomic<uint32_t> used;
+        atomic<uint64_t> done;
+        atomic<bool> stopping;
+        atomic<bool> ponder_hit; // ponderhit() was called for the running (or starting) ponder search
+        atomic<uint64_t> limit; // playouts of the running search
+        atomic<int64_t> deadline; // steady_clock time of the running search, 0 for none
+        ChessState root;
+
+        void worker(uint32_t id);
+        void apply_limits(); // the configured playouts and time, from now on
+        uint32_t alloc(uint32_t n); // index of n fresh nodes, 0 when the arena is full
+        void init(uint32_t idx, minfo mv, float prior);
+        bool expand(uint32_t idx, ChessState& pos, ChessState& backup, vector<minfo>& moves);
+        uint32_t select(const MCTSNode& node);
+        uint8_t playout(ChessState& pos, ChessState& backup, vector<minfo>& moves, mt19937_64& rng);
+};
+
+#define INV_CAST 0xFF // minfo.castle of "no move"
+
+#endif
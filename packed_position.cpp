@@ -0,0 +1,115 @@
+#include "packed_position.h"
+#include <cstring>
+#include <endian.h>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint8_t promo_piece[5] = {EMP,WN,WB,WR,WQ}; // white pieces, BP-WP is added for black
+
+void pack_position(const ChessState& pos, minfo mv, uint8_t result, PackedPosition& rec) {
+    for(uint8_t sq=0; sq<SZ*SZ; sq+=2)
+        rec.board[sq/2] = pos.board[sq/SZ][sq%SZ] | (pos.board[(sq+1)/SZ][(sq+1)%SZ]<<4);
+    rec.flags = (pos.active==WT) | (pos.cast<<1);
+    rec.enpassant = pos.enpassant;
+    rec.result = result;
+    rec.hmove = min<uint32_t>(pos.hmove,255);
+    rec.fmove = htole16(min<uint32_t>(pos.fmove,65535));
+
+    uint8_t piece = pos.board[mv.sq1/SZ][mv.sq1%SZ];
+    uint16_t promo = 0;
+    if(piece!=mv.newp) // promotion: the new piece's type, N=1..Q=4
+        promo = IS_WHITE(mv.newp) ? mv.newp-WP : mv.newp-BP;
+    rec.move = htole16(mv.sq1 | (mv.sq2<<6) | (promo<<12));
+}
+
+ChessState unpack_position(const PackedPosition& rec) {
+    // rebuilt through the FEN constructor, which also fills the piece sets
+    string fen;
+    for(uint8_t r=0; r<SZ; r++) {
+        uint8_t empty = 0;
+        for(uint8_t c=0; c<SZ; c++) {
+            uint8_t sq = r*SZ+c;
+            uint8_t piece = (rec.board[sq/2]>>(4*(sq%2)))&0xF;
+            if(piece==EMP) {
+                empty++;
+                continue;
+            }
+            if(empty)
+                fen += '0'+empty;
+            empty = 0;
+            fen += " PNBRQKpnbrqk"[piece];
+        }
+        if(empty)
+            fen += '0'+empty;
+        fen += (r==SZ-1) ? ' ' : '/';
+    }
+    fen += (rec.flags&1) ? "w " : "b ";
+    uint8_t cast = rec.flags>>1;
+    if((cast>>WKCAST)%2) fen += 'K';
+    if((cast>>WQCAST)%2) fen += 'Q';
+    if((cast>>BKCAST)%2) fen += 'k';
+    if((cast>>BQCAST)%2) fen += 'q';
+    if(cast==0) fen += '-';
+    fen += ' ';
+    if(rec.enpassant<SZ*SZ) {
+        fen += 'a'+rec.enpassant%SZ;
+        fen += '0'+SZ-rec.enpassant/SZ;
+    } else
+        fen += '-';
+    fen += " "+to_string(rec.hmove)+" "+to_string(le16toh(rec.fmove));
+    return ChessState(fen);
+}
+
+minfo unpack_move(const PackedPosition& rec) {
+    minfo mv;
+    uint16_t move = le16toh(rec.move);
+    mv.sq1 = move&63;
+    mv.sq2 = (move>>6)&63;
+    uint8_t piece = (rec.board[mv.sq1/2]>>(4*(mv.sq1%2)))&0xF;
+    uint8_t promo = (move>>12)&7;
+    mv.newp = promo ? promo_piece[promo]+(IS_BLACK(piece) ? BP-WP : 0) : piece;
+    mv.castle = NCAST;
+    if(piece==WK||piece==BK) { // the king moves two squares when castling
+        if(mv.sq2==mv.sq1+2)
+            mv.castle = KCAST;
+        else if(mv.sq2+2==mv.sq1)
+            mv.castle = QCAST;
+    }
+    return mv;
+}
+
+PositionFile::PositionFile(const string& path) {
+    int fd = open(path.c_str(),O_RDONLY);
+    if(fd<0)
+        throw runtime_error("cannot open "+path);
+    struct stat st;
+    fstat(fd,&st);
+    nbytes = st.st_size;
+    nrecords = nbytes/sizeof(PackedPosition);
+    records = NULL;
+    if(nbytes>0) {
+        void* ptr = mmap(NULL,nbytes,PROT_READ,MAP_SHARED,fd,0);
+        if(ptr==MAP_FAILED) {
+            close(fd);
+            throw runtime_error("cannot map "+path);
+        }
+        records = (const PackedPosition*)ptr;
+    }
+    close(fd);
+}
+
+PositionFile::~PositionFile() {
+    if(records)
+        munmap((void*)records,nbytes);
+}
+
+size_t PositionFile::size() const {
+    return nrecords;
+}
+
+const PackedPosition& PositionFile::operator[](size_t idx) const {
+    return records[idx];
+}
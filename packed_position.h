@@ -0,0 +1,38 @@
+#ifndef PACKED_POSITION_H
+#define PACKED_POSITION_H
+#include "chess_state.h"
+
+#define UNKNOWN_RESULT 0xFF // PackedPosition::result of unfinished games
+
+// fixed-size training record, 40 bytes: record i of a file is at offset 40*i
+// move and fmove are little-endian on every host, read them through unpack_position and unpack_move
+struct PackedPosition {
+    uint8_t board[SZ*SZ/2]; // 4 bits per square, square 2i in the low nibble, a8=0..h1=63, pieces as in chess_state.h
+    uint8_t flags; // bit 0: white to move, bits 1-4: castling availability (ChessState::cast)
+    uint8_t enpassant; // square, SZ*SZ when not available
+    uint8_t result; // WHITE_WINS, DRAWN, BLACK_WINS or UNKNOWN_RESULT
+    uint8_t hmove; // half-move clock, capped at 255
+    uint16_t move; // played move: from | to<<6 | promotion<<12 (0 none, 1 N, 2 B, 3 R, 4 Q)
+    uint16_t fmove; // full-move clock, capped at 65535
+};
+static_assert(sizeof(PackedPosition)==40,"PackedPosition must stay 40 bytes");
+
+void pack_position(const ChessState& pos, minfo mv, uint8_t result, PackedPosition& rec);
+ChessState unpack_position(const PackedPosition& rec);
+minfo unpack_move(const PackedPosition& rec); // the played move in rec's position
+
+class PositionFile { // read-only memory map of a file of PackedPosition records
+    public:
+        PositionFile(const string& path); // throws runtime_error if the file cannot be mapped
+        PositionFile(const PositionFile&) = delete; // a copy would unmap the records a second time
+        PositionFile& operator=(const PositionFile&) = delete;
+        ~PositionFile();
+        size_t size() const; // number of records
+        const PackedPosition& operator[](size_t idx) const;
+    private:
+        const PackedPosition* records;
+        size_t nrecords;
+        size_t nbytes;
+};
+
+#endif
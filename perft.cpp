@@ -0,0 +1,81 @@
+#include "chess_state.h"
+#include <chrono>
+#include <cstdlib>
+
+// counts the leaf nodes of the legal move tree, to check move generation and compare board representations:
+// perft [--depth N] [--board B|all] [FEN]
+// B is bitboard (ChessState), mailbox, pieces or 0x88, with all every one of them must find the same counts
+
+template<class Board>
+static uint64_t perft(BasicChessState<Board>& pos, uint32_t depth, vector<vector<minfo> >& lists) {
+    vector<minfo>& list = lists[depth];
+    list.clear();
+    pos.all_legal_moves(list);
+    if(depth==1)
+        return list.size();
+    uint64_t nodes = 0;
+    for(minfo mv: list) {
+        BasicChessState<Board> child = pos;
+        child.execute_move(mv);
+        nodes += perft(child,depth-1,lists);
+    }
+    return nodes;
+}
+
+template<class Board>
+static uint64_t run(const string& fen, uint32_t depth, const string& name) {
+    BasicChessState<Board> pos(fen);
+    vector<vector<minfo> > lists(depth+1);
+    for(vector<minfo>& list: lists)
+        list.reserve(MAX_MOVES);
+    auto stime = chrono::steady_clock::now();
+    uint64_t nodes = depth ? perft(pos,depth,lists) : 1;
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+    cout << name << ": " << nodes << " nodes in " << secs << "s (" << (uint64_t)(nodes/max(secs,1e-9)) << " nodes/s)" << endl;
+    return nodes;
+}
+
+int main(int argc, char** argv) {
+    uint32_t depth = 4;
+    vector<string> boards = {"bitboard"};
+    string fen = ChessState().get_FEN();
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--depth"&&i+1<argc) depth = atoi(argv[++i]);
+        else if(opt=="--board"&&i+1<argc) {
+            string name = argv[++i];
+            if(name=="all")
+                boards = {"bitboard","mailbox","pieces","0x88"};
+            else
+                boards = {name};
+        } else if(opt[0]=='-') {
+            cerr << "usage: " << argv[0] << " [--depth N] [--board bitboard|mailbox|pieces|0x88|all] [FEN]" << endl;
+            return 1;
+        } else
+            fen = opt;
+    }
+
+    vector<uint64_t> counts;
+    try {
+        for(const string& name: boards) {
+            if(name=="bitboard") counts.push_back(run<BitboardBoard>(fen,depth,name));
+            else if(name=="mailbox") counts.push_back(run<MailboxBoard>(fen,depth,name));
+            else if(name=="pieces") counts.push_back(run<PieceListBoard>(fen,depth,name));
+            else if(name=="0x88") counts.push_back(run<X88Board>(fen,depth,name));
+            else {
+                cerr << "unknown board " << name << " (bitboard, mailbox, pieces, 0x88 or all)" << endl;
+                return 1;
+            }
+        }
+    } catch(const invalid_argument& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    for(uint64_t n: counts) {
+        if(n!=counts[0]) {
+            cerr << "the board representations disagree" << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
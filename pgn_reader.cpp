@@ -0,0 +1,120 @@
+#include "pgn_reader.h"
+#include <cstring>
+
+const char* PGNGame::tag(const char* name) const {
+    for(const auto& tg: tags) {
+        if(tg.first==name)
+            return tg.second.c_str();
+    }
+    return NULL;
+}
+
+void PGNGame::clear() {
+    tags.clear();
+    moves.clear();
+    result.clear();
+}
+
+PGNReader::PGNReader(istream& in) : in(in) {
+    nline = 0;
+}
+
+uint64_t PGNReader::line_number() const {
+    return nline;
+}
+
+void PGNReader::parse_tag(PGNGame& game) {
+    // [Name "Value"], backslash escapes quotes inside the value
+    size_t name_end = line.find_first_of(" \"",1);
+    size_t qstart = line.find('"');
+    if(name_end==string::npos||qstart==string::npos)
+        return;
+    string value;
+    for(size_t i=qstart+1; i<line.size()&&line[i]!='"'; i++) {
+        if(line[i]=='\\'&&i+1<line.size())
+            i++;
+        value += line[i];
+    }
+    game.tags.push_back(make_pair(line.substr(1,name_end-1),value));
+}
+
+static bool token_is(const char* tok, const char* end, const char* word) {
+    size_t len = strlen(word);
+    return (size_t)(end-tok)==len && strncmp(tok,word,len)==0;
+}
+
+bool PGNReader::parse_movetext(PGNGame& game, uint32_t& comment_depth, uint32_t& variation_depth) {
+    const char* ch = line.c_str();
+    while(*ch) {
+        if(comment_depth) { // {comments} can span lines
+            if(*ch=='}')
+                comment_depth = 0;
+            ch++;
+        } else if(*ch=='{') {
+            comment_depth = 1;
+            ch++;
+        } else if(*ch==';') { // comment until end of line
+            break;
+        } else if(*ch=='(') { // (variations) can nest
+            variation_depth++;
+            ch++;
+        } else if(*ch==')') {
+            if(variation_depth)
+                variation_depth--;
+            ch++;
+        } else if(isspace(*ch)) {
+            ch++;
+        } else {
+            const char* end = ch+strcspn(ch," \t\r\n{}();");
+            if(variation_depth==0) {
+                if(*ch=='$') { // NAG
+                } else if(token_is(ch,end,"1-0")||token_is(ch,end,"0-1")
+                        ||token_is(ch,end,"1/2-1/2")||token_is(ch,end,"*")) {
+                    game.result.assign(ch,end);
+                    return true;
+                } else {
+                    const char* san = ch;
+                    while(san<end&&isdigit(*san)) // move number: "12." or "12..." or "12.e4"
+                        san++;
+                    if(san<end&&*san=='.') {
+                        while(san<end&&*san=='.')
+                            san++;
+                    } else
+                        san = ch;
+                    const char* san_end = end;
+                    while(san_end>san&&(san_end[-1]=='!'||san_end[-1]=='?'))
+                        san_end--;
+                    if(san_end>san)
+                        game.moves.push_back(string(san,san_end));
+                }
+            }
+            ch = end;
+        }
+    }
+    return false;
+}
+
+bool PGNReader::next(PGNGame& game) {
+    game.clear();
+    bool in_movetext = false;
+    uint32_t comment_depth = 0;
+    uint32_t variation_depth = 0;
+    while(true) {
+        // a tag after the movetext starts the next game (for files without result tokens)
+        if(in_movetext&&comment_depth==0&&in.peek()=='[')
+            return true;
+        if(!getline(in,line))
+            return in_movetext||!game.tags.empty();
+        nline++;
+        if(!line.empty()&&line.back()=='\r')
+            line.pop_back();
+
+        if(!in_movetext&&!line.empty()&&line[0]=='[')
+            parse_tag(game);
+        else if(in_movetext||line.find_first_not_of(" \t")!=string::npos) {
+            in_movetext = true;
+            if(parse_movetext(game,comment_depth,variation_depth))
+                return true;
+        }
+    }
+}
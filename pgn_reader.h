@@ -0,0 +1,29 @@
+#ifndef PGN_READER_H
+#define PGN_READER_H
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct PGNGame {
+    vector<pair<string,string> > tags; // in file order
+    vector<string> moves; // SAN without move numbers, comments, variations, NAGs or !? annotations
+    string result; // "1-0", "0-1", "1/2-1/2", "*" (empty if the movetext has none)
+    const char* tag(const char* name) const; // NULL if the tag is missing
+    void clear();
+};
+
+class PGNReader { // streams games from a PGN file
+    public:
+        PGNReader(istream& in);
+        bool next(PGNGame& game); // reads the next game, false at end of input
+        uint64_t line_number() const; // for error messages
+    private:
+        istream& in;
+        string line;
+        uint64_t nline;
+        void parse_tag(PGNGame& game);
+        bool parse_movetext(PGNGame& game, uint32_t& comment_depth, uint32_t& variation_depth); // true at the result token
+};
+
+#endif
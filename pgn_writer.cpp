@@ -0,0 +1,109 @@
+#include "pgn_writer.h"
+#include <cstring>
+
+PGNWriter::PGNWriter(uint8_t width) {
+    this->width = width;
+    clear();
+}
+
+void PGNWriter::tag(const char* name, const char* value) {
+    buf += '[';
+    buf += name;
+    buf += " \"";
+    for(const char* ch=value; *ch; ch++) { // quotes and backslashes are escaped
+        if(*ch=='"'||*ch=='\\')
+            buf += '\\';
+        buf += *ch;
+    }
+    buf += "\"]\n";
+}
+
+void PGNWriter::start(uint32_t fmove, bool active) {
+    buf += '\n'; // blank line between tags and movetext
+    line_start = buf.size();
+    flushed = 0;
+    this->fmove = fmove;
+    this->active = active;
+    need_number = true;
+}
+
+void PGNWriter::token(const char* tok, size_t len) {
+    size_t line_len = flushed+buf.size()-line_start;
+    if(line_len>0) {
+        if(line_len+1+len>width) {
+            buf += '\n';
+            line_start = buf.size();
+            flushed = 0;
+        } else
+            buf += ' ';
+    }
+    buf.append(tok,len);
+}
+
+void PGNWriter::move(const char* san, const char* comment) {
+    char num[16];
+    if(active) // white's move: "12."
+        token(num,snprintf(num,sizeof(num),"%u.",fmove));
+    else if(need_number) // black's move after an interruption: "12..."
+        token(num,snprintf(num,sizeof(num),"%u...",fmove));
+    token(san,strlen(san));
+    need_number = false;
+
+    if(!active)
+        fmove++;
+    active = !active;
+    if(comment)
+        this->comment(comment);
+}
+
+void PGNWriter::comment(const char* text) {
+    // comments may be split across lines, but each word is kept whole
+    token("{",1);
+    const char* word = text;
+    bool first = true;
+    while(*word) {
+        while(*word==' '||*word=='\n')
+            word++;
+        size_t len = strcspn(word," \n}");
+        if(len==0)
+            break;
+        if(first)
+            buf.append(word,len);
+        else
+            token(word,len);
+        first = false;
+        word += len;
+        if(*word=='}') // a closing brace cannot appear inside a comment
+            word++;
+    }
+    buf += '}';
+    need_number = true;
+}
+
+void PGNWriter::result(const char* res) {
+    token(res,strlen(res));
+    buf += "\n\n";
+    line_start = buf.size();
+    flushed = 0;
+}
+
+const string& PGNWriter::str() const {
+    return buf;
+}
+
+void PGNWriter::flush(ostream& os) {
+    // the game in progress continues: only the buffer is emptied, the move number and line length are kept
+    os.write(buf.data(),buf.size());
+    flushed += buf.size()-line_start;
+    buf.clear();
+    line_start = 0;
+}
+
+void PGNWriter::clear() {
+    buf.clear();
+    line_start = 0;
+    flushed = 0;
+    fmove = 1;
+    active = true;
+    need_number = true;
+}
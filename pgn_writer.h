@@ -0,0 +1,34 @@
+#ifndef PGN_WRITER_H
+#define PGN_WRITER_H
+
+#include <iostream>
+#include <string>
+#include <cstdint>
+using namespace std;
+
+#define PGN_WIDTH 80 // maximum line length of the movetext
+
+class PGNWriter { // writes games in PGN into a reusable buffer
+    public:
+        PGNWriter(uint8_t width=PGN_WIDTH);
+        void tag(const char* name, const char* value); // tags must come before the first move
+        void start(uint32_t fmove=1, bool active=true); // begin the movetext at a FEN's move clock and active player (true for white)
+        void move(const char* san, const char* comment=NULL);
+        void comment(const char* text); // {text} after the last move
+        void result(const char* res); // "1-0", "0-1", "1/2-1/2" or "*", ends the game
+        const string& str() const; // every game written since the last clear()
+        void flush(ostream& os); // write the buffer to os and empty it, a game in progress can continue
+        void clear(); // keeps the buffer's capacity
+
+    private:
+        string buf;
+        uint8_t width;
+        size_t line_start; // index in buf where the current movetext line starts
+        size_t flushed; // length of the current line already written by flush()
+        uint32_t fmove;
+        bool active;
+        bool need_number; // black's move needs "N..." after a comment or at the start
+        void token(const char* tok, size_t len); // adds a token to the movetext, wrapping lines
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef POLYGLOT_H
+#define POLYGLOT_H
+#include "chess_state.h"
+#include <random>
+
+// Polyglot opening books: 16-byte big-endian entries (key, move, weight, learn) sorted by key.
+// Keys use the Polyglot Zobrist scheme (piece 64*kind+8*rank+file, castling 768, en passant 772, turn 780)
+// over the official table of 781 random numbers, built in, so books from other tools can be probed.
+// polyglot_load_randoms replaces it (e.g. for books keyed with a different table).
+
+#define POLYGLOT_RANDOMS 781
+#define POLYGLOT_START_KEY 0x463B96181691FC9CULL // key of the starting position with the official table
+
+struct PolyglotEntry {
+    uint64_t key;
+    uint16_t move; // to file | to rank<<3 | from file<<6 | from rank<<9 | promotion<<12, castling is king takes rook
+    uint16_t weight;
+    uint32_t learn;
+};
+
+bool polyglot_load_randoms(const string& path); // reads the first 781 hex numbers of a file, false on failure
+bool polyglot_official(); // does the table in use give the official starting position key?
+uint64_t polyglot_key(const ChessState& pos);
+uint16_t polyglot_move(const ChessState& pos, minfo mv);
+bool polyglot_minfo(ChessState& pos, uint16_t move, minfo& mv); // the legal move of a book move, false if illegal
+
+class PolyglotBook { // read-only memory map of a book
+    public:
+        PolyglotBook(const string& path); // throws runtime_error if the file cannot be mapped
+        ~PolyglotBook();
+        size_t size() const; // number of entries
+        PolyglotEntry entry(size_t idx) const;
+        size_t probe(uint64_t key, vector<PolyglotEntry>& entries) const; // appends all entries of key, returns how many
+        bool pick(ChessState& pos, minfo& mv, mt19937_64& rng) const; // legal book move chosen by weight, false if none
+    private:
+        const uint8_t* data;
+        size_t nbytes;
+};
+
+void polyglot_write(const string& path, vector<PolyglotEntry>& entries); // sorts entries by key (and weight) first
+
+#endif
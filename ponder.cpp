@@ -0,0 +1,53 @@
+#include "ponder.h"
+
+Ponderer::Ponderer(MCTS& mcts): mcts(mcts) {
+    reply.castle = INV_CAST;
+}
+
+Ponderer::~Ponderer() {
+    cancel();
+}
+
+bool Ponderer::pondering() const {
+    return th.joinable();
+}
+
+minfo Ponderer::expected() const {
+    return reply;
+}
+
+bool Ponderer::start(const ChessState& pos) {
+    cancel();
+    reply = mcts.expected_reply();
+    if(reply.castle==INV_CAST)
+        return false;
+    target = pos;
+    target.execute_move(reply);
+    th = thread([this]() {
+        best = mcts.search(target,true);
+    });
+    return true;
+}
+
+bool Ponderer::finish(const ChessState& pos, minfo& mv) {
+    if(!pondering())
+        return false;
+    if(pos.hash()!=target.hash()) {
+        cancel();
+        return false;
+    }
+    // the search continues with the configured limits (it may already be past them)
+    mcts.ponderhit();
+    th.join();
+    mv = best;
+    reply.castle = INV_CAST;
+    return mv.castle!=INV_CAST;
+}
+
+void Ponderer::cancel() {
+    if(!pondering())
+        return;
+    mcts.stop();
+    th.join();
+    reply.castle = INV_CAST;
+}
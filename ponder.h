@@ -0,0 +1,25 @@
+#ifndef PONDER_H
+#define PONDER_H
+#include "mcts.h"
+#include <thread>
+
+// searches on the opponent's time: after the engine moves, the position after the expected reply is
+// searched in a background thread until the opponent's move arrives
+class Ponderer {
+    public:
+        Ponderer(MCTS& mcts);
+        ~Ponderer(); // cancels
+        bool start(const ChessState& pos); // pos: the opponent to move, right after mcts searched the previous position
+        bool finish(const ChessState& pos, minfo& mv); // pos after the opponent's move: true and the search's move on a hit
+        void cancel(); // stops and discards the background search
+        bool pondering() const;
+        minfo expected() const; // the reply being pondered
+    private:
+        MCTS& mcts;
+        thread th;
+        ChessState target; // position after the expected reply
+        minfo reply;
+        minfo best; // written by the background thread
+};
+
+#endif
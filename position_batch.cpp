@@ -0,0 +1,156 @@
+#include "position_batch.h"
+#include "batch_kernels.h"
+
+struct ScalarOps { // one position per "register"
+    typedef uint64_t V;
+    static const size_t WIDTH = 1;
+
+    static V load(const uint64_t* p) { return *p; }
+    static void store(uint64_t* p, V a) { *p = a; }
+    static V set1(uint64_t x) { return x; }
+    static V and_(V a, V b) { return a&b; }
+    static V or_(V a, V b) { return a|b; }
+    static V andnot(V a, V b) { return ~a&b; }
+    static V add(V a, V b) { return a+b; }
+    static V sub(V a, V b) { return a-b; }
+    template<int S> static V shl(V a) { return a<<S; }
+    template<int S> static V shr(V a) { return a>>S; }
+    static V popcount(V a) { return __builtin_popcountll(a); }
+    static void store_nonzero(uint8_t* p, V a) { *p = a!=0; }
+    static void store_u16(uint16_t* p, V a) { *p = a; }
+    static void store_i32(int32_t* p, V a) { *p = (int32_t)(int64_t)a; }
+};
+
+#ifndef BATCH_NO_AVX2
+// position_batch_avx2.cpp
+size_t batch_avx2_width();
+void batch_attacks_avx2(const BatchView& b, bool white, size_t lo, size_t hi, uint64_t* out);
+void batch_in_check_avx2(const BatchView& b, size_t lo, size_t hi, uint8_t* out);
+void batch_mobility_avx2(const BatchView& b, size_t lo, size_t hi, uint16_t* out);
+void batch_material_avx2(const BatchView& b, size_t lo, size_t hi, int32_t* out);
+#endif
+
+PositionBatch::PositionBatch() : simd(true) {}
+
+void PositionBatch::push(const ChessState& pos) {
+    for(int p=0; p<12; p++)
+        pieces[p].push_back(pos.psquares[p+WP].mask());
+    white.push_back((pos.active==WT) ? ~0ULL : 0);
+    cast.push_back(pos.cast);
+    enpassant.push_back(pos.enpassant);
+    hmove.push_back(pos.hmove);
+    fmove.push_back(pos.fmove);
+}
+
+void PositionBatch::push_fen(const string& fen) {
+    push(ChessState(fen));
+}
+
+ChessState PositionBatch::get(size_t i) const {
+    if(i>=size())
+        throw out_of_range("PositionBatch::get");
+    ChessState pos;
+    pos.clear();
+    for(int p=0; p<12; p++) {
+        for(uint64_t bits=pieces[p][i]; bits; bits&=bits-1)
+            pos.put(__builtin_ctzll(bits),p+WP);
+    }
+    pos.active = white[i] ? WT : BT;
+    pos.cast = cast[i];
+    pos.enpassant = enpassant[i];
+    pos.hmove = hmove[i];
+    pos.fmove = fmove[i];
+    return pos;
+}
+
+string PositionBatch::get_FEN(size_t i) const {
+    return get(i).get_FEN();
+}
+
+void PositionBatch::reserve(size_t n) {
+    for(int p=0; p<12; p++)
+        pieces[p].reserve(n);
+    white.reserve(n);
+    cast.reserve(n);
+    enpassant.reserve(n);
+    hmove.reserve(n);
+    fmove.reserve(n);
+}
+
+void PositionBatch::clear() {
+    for(int p=0; p<12; p++)
+        pieces[p].clear();
+    white.clear();
+    cast.clear();
+    enpassant.clear();
+    hmove.clear();
+    fmove.clear();
+}
+
+bool PositionBatch::simd_available() {
+#if !defined(BATCH_NO_AVX2)&&(defined(__x86_64__)||defined(__i386__))
+    static bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+bool PositionBatch::use_simd() const {
+    return simd&&simd_available();
+}
+
+// every kernel: the AVX2 loop over whole registers, the scalar loop over the rest (or everything)
+#ifndef BATCH_NO_AVX2
+#define BATCH_SPLIT(n) size_t split = use_simd() ? (n)-(n)%batch_avx2_width() : 0
+#else
+#define BATCH_SPLIT(n) size_t split = 0
+#endif
+
+static BatchView view_of(const vector<uint64_t>* pieces, const vector<uint64_t>& white) {
+    BatchView b;
+    for(int p=0; p<12; p++)
+        b.pieces[p] = pieces[p].data();
+    b.white = white.data();
+    return b;
+}
+
+void PositionBatch::attacks(bool side, uint64_t* out) const {
+    BatchView b = view_of(pieces,white);
+    BATCH_SPLIT(size());
+#ifndef BATCH_NO_AVX2
+    if(split)
+        batch_attacks_avx2(b,side==WT,0,split,out);
+#endif
+    attacks_loop<ScalarOps>(b,side==WT,split,size(),out);
+}
+
+void PositionBatch::in_check(uint8_t* out) const {
+    BatchView b = view_of(pieces,white);
+    BATCH_SPLIT(size());
+#ifndef BATCH_NO_AVX2
+    if(split)
+        batch_in_check_avx2(b,0,split,out);
+#endif
+    check_loop<ScalarOps>(b,split,size(),out);
+}
+
+void PositionBatch::mobility(uint16_t* out) const {
+    BatchView b = view_of(pieces,white);
+    BATCH_SPLIT(size());
+#ifndef BATCH_NO_AVX2
+    if(split)
+        batch_mobility_avx2(b,0,split,out);
+#endif
+    mobility_loop<ScalarOps>(b,split,size(),out);
+}
+
+void PositionBatch::material(int32_t* out) const {
+    BatchView b = view_of(pieces,white);
+    BATCH_SPLIT(size());
+#ifndef BATCH_NO_AVX2
+    if(split)
+        batch_material_avx2(b,0,split,out);
+#endif
+    material_loop<ScalarOps>(b,split,size(),out);
+}
@@ -0,0 +1,39 @@
+#ifndef POSITION_BATCH_H
+#define POSITION_BATCH_H
+#include "chess_state.h"
+
+// many unrelated positions stored column-wise (a bitboard column per piece) for bulk queries
+// the kernels run on AVX2 (4 positions per instruction) when the CPU has it, otherwise on scalar bitboards
+
+class PositionBatch {
+    public:
+        PositionBatch();
+        void push(const ChessState& pos);
+        void push_fen(const string& fen); // throws invalid_argument like ChessState(fen)
+        ChessState get(size_t i) const;
+        string get_FEN(size_t i) const;
+        size_t size() const { return white.size(); }
+        void reserve(size_t n);
+        void clear();
+
+        // one result per position, out must hold size() values
+        void attacks(bool side, uint64_t* out) const; // squares attacked by side (WT or BT)
+        void in_check(uint8_t* out) const; // 1 when the side to move is in check
+        void mobility(uint16_t* out) const; // squares attacked by the side to move that it does not occupy itself
+        void material(int32_t* out) const; // white minus black, P=1 N=B=3 R=5 Q=9
+
+        static bool simd_available(); // AVX2 kernels compiled in and supported by this CPU
+        bool simd; // use the AVX2 kernels when available (default), false forces the scalar ones
+
+    private:
+        vector<uint64_t> pieces[12]; // bitboard per piece, index piece-1
+        vector<uint64_t> white; // all ones when white is to move
+        vector<uint8_t> cast;
+        vector<uint8_t> enpassant;
+        vector<uint32_t> hmove;
+        vector<uint32_t> fmove;
+
+        bool use_simd() const;
+};
+
+#endif
@@ -0,0 +1,55 @@
+// AVX2 kernels of PositionBatch, this file alone is compiled with -mavx2 (see Makefile) and is only called
+// after a CPU check, so nothing here may be shared with the rest of the build
+#ifndef BATCH_NO_AVX2
+#include <immintrin.h>
+#include "batch_kernels.h"
+
+struct AVX2Ops { // four positions per register
+    typedef __m256i V;
+    static const size_t WIDTH = 4;
+
+    static V load(const uint64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static void store(uint64_t* p, V a) { _mm256_storeu_si256((__m256i*)p,a); }
+    static V set1(uint64_t x) { return _mm256_set1_epi64x(x); }
+    static V and_(V a, V b) { return _mm256_and_si256(a,b); }
+    static V or_(V a, V b) { return _mm256_or_si256(a,b); }
+    static V andnot(V a, V b) { return _mm256_andnot_si256(a,b); } // ~a&b
+    static V add(V a, V b) { return _mm256_add_epi64(a,b); }
+    static V sub(V a, V b) { return _mm256_sub_epi64(a,b); }
+    template<int S> static V shl(V a) { return _mm256_slli_epi64(a,S); }
+    template<int S> static V shr(V a) { return _mm256_srli_epi64(a,S); }
+
+    static V popcount(V a) {
+        // nibble counts by table lookup, summed per 64-bit lane
+        const V table = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+        const V low = _mm256_set1_epi8(0x0F);
+        V lo = _mm256_shuffle_epi8(table,_mm256_and_si256(a,low));
+        V hi = _mm256_shuffle_epi8(table,_mm256_and_si256(_mm256_srli_epi16(a,4),low));
+        return _mm256_sad_epu8(_mm256_add_epi8(lo,hi),_mm256_setzero_si256());
+    }
+    static void store_nonzero(uint8_t* p, V a) {
+        int zero = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a,_mm256_setzero_si256())));
+        for(int k=0; k<4; k++)
+            p[k] = !((zero>>k)&1);
+    }
+    static void store_u16(uint16_t* p, V a) {
+        uint64_t tmp[4];
+        store(tmp,a);
+        for(int k=0; k<4; k++)
+            p[k] = tmp[k];
+    }
+    static void store_i32(int32_t* p, V a) {
+        uint64_t tmp[4];
+        store(tmp,a);
+        for(int k=0; k<4; k++)
+            p[k] = (int32_t)(int64_t)tmp[k];
+    }
+};
+
+// [lo,hi) with hi-lo a multiple of 4, PositionBatch does the remainder with the scalar kernels
+size_t batch_avx2_width() { return AVX2Ops::WIDTH; }
+void batch_attacks_avx2(const BatchView& b, bool white, size_t lo, size_t hi, uint64_t* out) { attacks_loop<AVX2Ops>(b,white,lo,hi,out); }
+void batch_in_check_avx2(const BatchView& b, size_t lo, size_t hi, uint8_t* out) { check_loop<AVX2Ops>(b,lo,hi,out); }
+void batch_mobility_avx2(const BatchView& b, size_t lo, size_t hi, uint16_t* out) { mobility_loop<AVX2Ops>(b,lo,hi,out); }
+void batch_material_avx2(const BatchView& b, size_t lo, size_t hi, int32_t* out) { material_loop<AVX2Ops>(b,lo,hi,out); }
+#endif
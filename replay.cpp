@@ -0,0 +1,142 @@
+#include "chess_interface.h"
+#include "pgn_reader.h"
+#include "chess_stats.h"
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+// replays PGN games through ChessInterface and reports plies per second
+// --count-allocs: after one warm-up pass, fail if replaying the games allocates on the heap
+// --board: board representation (see board_policies.h), all: each of them in turn
+
+static atomic<uint64_t> allocations(0);
+static bool counting = false;
+
+void* operator new(size_t size) {
+    if(counting)
+        allocations.fetch_add(1,memory_order_relaxed);
+    void* ptr = malloc(size ? size : 1);
+    if(ptr==NULL)
+        throw bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+template<class Board>
+static uint64_t replay(BasicChessInterface<Board>& cgame, const BasicChessState<Board>& start, const vector<PGNGame>& games) {
+    // returns the number of plies played
+    uint64_t plies = 0;
+    for(size_t g=0; g<games.size(); g++) {
+        cgame.set_state(start);
+        for(const string& san: games[g].moves) {
+            if(!cgame.play_san(san.c_str())) {
+                counting = false;
+                cerr << "game " << g+1 << ": " << san << " is not a legal move" << endl;
+                exit(1);
+            }
+            plies++;
+        }
+    }
+    return plies;
+}
+
+template<class Board>
+static int run(const vector<PGNGame>& games, uint32_t repeat, bool count_allocs, const string& label) {
+    BasicChessState<Board> start;
+    BasicChessInterface<Board> cgame;
+    replay(cgame,start,games); // warm-up: scratch lists reach their final capacity
+
+    if(count_allocs) {
+        allocations = 0;
+        counting = true;
+        uint64_t plies = replay(cgame,start,games);
+        counting = false;
+        cout << label << games.size() << " games, " << plies << " plies, " << allocations << " allocations" << endl;
+        if(allocations!=0) {
+            cerr << "replay allocated " << allocations << " times after warm-up" << endl;
+            return 1;
+        }
+    }
+
+    uint64_t plies = 0;
+    auto stime = chrono::steady_clock::now();
+    for(uint32_t r=0; r<repeat; r++)
+        plies += replay(cgame,start,games);
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+    cout << label << games.size()*repeat << " games, " << plies << " plies in " << secs << "s ("
+        << (uint64_t)(plies/secs) << " plies/s)" << endl;
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bool count_allocs = false;
+    bool stats_json = false;
+    uint32_t repeat = 1;
+    vector<string> boards = {"bitboard"};
+    bool labels = false; // name the board in the output when one was chosen
+    vector<PGNGame> games;
+    PGNGame game;
+    for(int i=1; i<argc; i++) {
+        if(strcmp(argv[i],"--count-allocs")==0)
+            count_allocs = true;
+        else if(strcmp(argv[i],"--repeat")==0&&i+1<argc)
+            repeat = atoi(argv[++i]);
+        else if(strcmp(argv[i],"--board")==0&&i+1<argc) {
+            string name = argv[++i];
+            if(name=="all")
+                boards = {"bitboard","mailbox","pieces","0x88"};
+            else if(name=="bitboard"||name=="mailbox"||name=="pieces"||name=="0x88")
+                boards = {name};
+            else {
+                cerr << "unknown board " << name << " (bitboard, mailbox, pieces, 0x88 or all)" << endl;
+                return 1;
+            }
+            labels = true;
+        }
+        else if(strcmp(argv[i],"--stats")==0||strcmp(argv[i],"--stats=json")==0) {
+            ChessStats::enabled = true;
+            stats_json = (strcmp(argv[i],"--stats=json")==0);
+        } else if(argv[i][0]=='-') {
+            cerr << "usage: " << argv[0] << " [--count-allocs] [--repeat N] [--board B|all] [--stats|--stats=json] file.pgn..." << endl;
+            return 1;
+        } else {
+            ifstream fin(argv[i]);
+            if(!fin) {
+                cerr << "cannot open " << argv[i] << endl;
+                return 1;
+            }
+            PGNReader reader(fin);
+            while(reader.next(game)) {
+                if(game.tag("FEN")!=NULL) // only games from the starting position
+                    continue;
+                games.push_back(game);
+            }
+        }
+    }
+
+    for(const string& name: boards) {
+        string label = labels ? name+": " : "";
+        int status = (name=="bitboard") ? run<BitboardBoard>(games,repeat,count_allocs,label)
+                   : (name=="mailbox") ? run<MailboxBoard>(games,repeat,count_allocs,label)
+                   : (name=="pieces") ? run<PieceListBoard>(games,repeat,count_allocs,label)
+                   : run<X88Board>(games,repeat,count_allocs,label);
+        if(status!=0)
+            return status;
+    }
+
+    if(ChessStats::enabled)
+        ChessStats::print(cerr,stats_json);
+    return 0;
+}
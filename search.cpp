@@ -0,0 +1,80 @@
+#include "chess_interface.h"
+#include "mcts.h"
+#include "polyglot.h"
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+// search [--fen FEN] [--playouts N] [--millis N] [--threads N] [--cpuct C] [--puct] [--bias P] [--nodes N] [--book book.bin]
+// prints the best move of one MCTS search and the playout rate, or the book move when the position is in the book
+int main(int argc, char** argv) {
+    MCTSConfig cfg;
+    string fen;
+    string book_path;
+    for(int i=1; i<argc; i++) {
+        string opt = argv[i];
+        if(opt=="--puct")
+            cfg.puct = true;
+        else if(opt=="--fen"&&i+1<argc)
+            fen = argv[++i];
+        else if(opt=="--playouts"&&i+1<argc&&atoll(argv[i+1])>0)
+            cfg.playouts = atoll(argv[++i]);
+        else if(opt=="--millis"&&i+1<argc)
+            cfg.millis = atoi(argv[++i]);
+        else if(opt=="--threads"&&i+1<argc)
+            cfg.threads = atoi(argv[++i]);
+        else if(opt=="--cpuct"&&i+1<argc)
+            cfg.cpuct = atof(argv[++i]);
+        else if(opt=="--bias"&&i+1<argc)
+            cfg.capture_bias = atof(argv[++i]);
+        else if(opt=="--nodes"&&i+1<argc)
+            cfg.max_nodes = atoi(argv[++i]);
+        else if(opt=="--book"&&i+1<argc)
+            book_path = argv[++i];
+        else { // unknown option, missing value or no playouts
+            cerr << "usage: " << argv[0] << " [--fen FEN] [--playouts N] [--millis N] [--threads N] [--cpuct C] [--puct] [--bias P] [--nodes N] [--book book.bin]" << endl;
+            return 1;
+        }
+    }
+    if(cfg.millis) // time-limited search
+        cfg.playouts = UINT64_MAX;
+
+    ChessInterface cgame;
+    try {
+        if(!fen.empty())
+            cgame.set_state(ChessState(fen));
+    } catch(const invalid_argument& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    if(!book_path.empty()) {
+        try {
+            PolyglotBook book(book_path);
+            mt19937_64 rng(cfg.seed);
+            minfo mv;
+            auto stime = chrono::steady_clock::now();
+            if(book.pick(cgame,mv,rng)) {
+                double usecs = chrono::duration<double,micro>(chrono::steady_clock::now()-stime).count();
+                cout << "bestmove " << cgame.to_san(mv) << " book (" << usecs << "us)" << endl;
+                return 0;
+            }
+        } catch(const runtime_error& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+
+    MCTS mcts(cfg);
+    auto stime = chrono::steady_clock::now();
+    minfo best = mcts.search(cgame);
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-stime).count();
+    if(best.castle==INV_CAST) {
+        cout << "no legal moves" << endl;
+        return 0;
+    }
+    cout << "bestmove " << cgame.to_san(best) << " value " << mcts.value() << endl;
+    cout << mcts.playouts() << " playouts in " << secs << "s (" << (uint64_t)(mcts.playouts()/secs)
+        << " playouts/s, " << cfg.threads << " threads), " << mcts.nodes() << " nodes" << endl;
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef SQUARE_SET_H
+#define SQUARE_SET_H
+#include <cstdint>
+
+// set of squares 0..63 stored as a 64-bit mask, iterates in increasing order like set<uint8_t>
+// (fixed size: copying a ChessState never allocates)
+class SquareSet {
+    public:
+        class iterator {
+            public:
+                iterator(uint64_t bits) : bits(bits) {}
+                uint8_t operator*() const { return __builtin_ctzll(bits); }
+                iterator& operator++() { bits &= bits-1; return *this; } // clear lowest square
+                bool operator!=(const iterator& other) const { return bits!=other.bits; }
+                bool operator==(const iterator& other) const { return bits==other.bits; }
+            private:
+                uint64_t bits;
+        };
+
+        SquareSet() : bits(0) {}
+        void insert(uint8_t sq) { bits |= 1ULL<<sq; }
+        void erase(uint8_t sq) { bits &= ~(1ULL<<sq); }
+        uint8_t count(uint8_t sq) const { return (bits>>sq)&1; }
+        uint8_t size() const { return __builtin_popcountll(bits); }
+        bool empty() const { return bits==0; }
+        void clear() { bits = 0; }
+        iterator begin() const { return iterator(bits); }
+        iterator end() const { return iterator(0); }
+        uint64_t mask() const { return bits; }
+
+    private:
+        uint64_t bits;
+};
+
+#endif
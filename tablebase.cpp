@@ -0,0 +1,472 @@
+#include "tablebase.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#define TB_UNRESOLVED 0xFD // during generation only, left over positions are draws
+#define TB_CHUNK (1<<16) // positions per generation job
+#define TB_ORDER "QRBNP" // canonical order of the stronger side's pieces
+#define TB_MAGIC "CTB1"
+
+static const int8_t king_steps[8][2] = {{-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1}};
+static const int8_t knight_steps[8][2] = {{-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1}};
+
+static uint8_t white_piece(char type) {
+    switch(type) {
+        case 'Q': return WQ;
+        case 'R': return WR;
+        case 'B': return WB;
+        case 'N': return WN;
+        case 'P': return WP;
+    }
+    return INV;
+}
+
+Tablebase::Tablebase(const string& sig): sig(sig) {
+    if(sig.size()<2||sig[0]!='K'||sig.back()!='K'||sig.size()-2>TB_MAX_PIECES)
+        throw invalid_argument("unsupported tablebase signature "+sig);
+    string order = TB_ORDER;
+    for(size_t i=1; i+1<sig.size(); i++) {
+        if(white_piece(sig[i])==INV||(i>1&&order.find(sig[i])<order.find(sig[i-1])))
+            throw invalid_argument("unsupported tablebase signature "+sig);
+        types.push_back(white_piece(sig[i]));
+    }
+}
+
+const string& Tablebase::signature() const {
+    return sig;
+}
+
+uint32_t Tablebase::size() const {
+    return 2U<<(6*(types.size()+2));
+}
+
+uint8_t Tablebase::value(uint32_t idx) const {
+    return data[idx];
+}
+
+uint32_t Tablebase::index(bool active, const uint8_t* sqs) const {
+    uint32_t idx = (active==WT) ? 0 : 1;
+    for(size_t i=0; i<types.size()+2; i++)
+        idx = idx*SZ*SZ+sqs[i];
+    return idx;
+}
+
+bool Tablebase::squares(const ChessState& pos, bool& active, uint8_t* sqs) const {
+    if(pos.cast)
+        return false;
+    uint8_t nwhite = 0, nblack = 0;
+    for(uint8_t p=WP; p<WK; p++) {
+        nwhite += pos.psquares[p].size();
+        nblack += pos.psquares[p+WK].size();
+    }
+    bool flip = nwhite==0&&nblack>0; // black is the stronger side: mirror the ranks and swap colors
+    if((flip ? nblack : nwhite)!=types.size()||(flip ? nwhite : nblack)!=0)
+        return false;
+    auto norm = [flip](uint8_t sq) { return flip ? (uint8_t)((SZ-1-sq/SZ)*SZ+sq%SZ) : sq; };
+    active = flip ? NEXT(pos.active) : pos.active;
+    sqs[0] = norm(*pos.psquares[flip ? BK : WK].begin());
+    sqs[1] = norm(*pos.psquares[flip ? WK : BK].begin());
+    size_t i = 0;
+    while(i<types.size()) {
+        uint8_t piece = flip ? types[i]+WK : types[i];
+        if(pos.psquares[piece].size()==0)
+            return false;
+        for(uint8_t sq: pos.psquares[piece]) {
+            if(i==types.size()||types[i]!=(flip ? piece-WK : piece))
+                return false;
+            sqs[2+i++] = norm(sq);
+        }
+    }
+    return true;
+}
+
+bool Tablebase::probe(const ChessState& pos, TBResult& res) const {
+    bool active;
+    uint8_t sqs[TB_MAX_PIECES+2];
+    if(data.empty()||!squares(pos,active,sqs))
+        return false;
+    uint8_t val = data[index(active,sqs)];
+    if(val==TB_ILLEGAL)
+        return false;
+    res.wdl = (val==TB_DRAW) ? 0 : (val%2) ? 1 : -1;
+    res.dtm = (val==TB_DRAW) ? 0 : val;
+    return true;
+}
+
+void Tablebase::load(const string& path) {
+    ifstream fin(path,ios::binary);
+    char header[12];
+    if(!fin||!fin.read(header,sizeof(header))||memcmp(header,TB_MAGIC,4)!=0||string(header+4,strnlen(header+4,8))!=sig)
+        throw runtime_error("cannot read "+sig+" tablebase from "+path);
+    data.resize(size());
+    if(!fin.read((char*)data.data(),data.size())) {
+        data.clear();
+        throw runtime_error("truncated tablebase "+path);
+    }
+}
+
+void Tablebase::save(const string& path) const {
+    ofstream fout(path,ios::binary);
+    char header[12] = {0};
+    memcpy(header,TB_MAGIC,4);
+    memcpy(header+4,sig.c_str(),sig.size());
+    if(!fout.write(header,sizeof(header))||!fout.write((const char*)data.data(),data.size()))
+        throw runtime_error("cannot write "+path);
+}
+
+string Tablebase::signature_of(const ChessState& pos) {
+    string white, black;
+    for(char type: string(TB_ORDER)) {
+        uint8_t piece = white_piece(type);
+        white.append(pos.psquares[piece].size(),type);
+        black.append(pos.psquares[piece+WK].size(),type);
+    }
+    if(!white.empty()&&!black.empty())
+        return "";
+    return "K"+white+black+"K";
+}
+
+bool Tablebase::mating_material(const string& sig) {
+    return sig.size()>=4||sig.find_first_of("QRP")!=string::npos;
+}
+
+TablebaseSet::TablebaseSet(const string& dir, uint32_t threads): dir(dir), nthreads(threads) {}
+
+TablebaseSet::~TablebaseSet() {
+    for(auto& kv: tables)
+        delete kv.second;
+}
+
+Tablebase* TablebaseSet::find(const string& sig) {
+    auto it = tables.find(sig);
+    if(it!=tables.end())
+        return it->second;
+    Tablebase* tb = new Tablebase(sig);
+    try {
+        tb->load(dir+"/"+sig+".ctb");
+    } catch(const runtime_error& e) {
+        delete tb;
+        return NULL;
+    }
+    tables[sig] = tb;
+    return tb;
+}
+
+const Tablebase& TablebaseSet::get(const string& sig) {
+    Tablebase* tb = find(sig);
+    if(tb)
+        return *tb;
+    tb = new Tablebase(sig);
+    try {
+        generate(*tb);
+        tb->save(dir+"/"+sig+".ctb");
+    } catch(...) {
+        delete tb;
+        throw;
+    }
+    tables[sig] = tb;
+    return *tb;
+}
+
+bool TablebaseSet::probe(const ChessState& pos, TBResult& res) {
+    string sig = Tablebase::signature_of(pos);
+    if(sig.empty()||sig.size()-2>TB_MAX_PIECES)
+        return false;
+    if(!Tablebase::mating_material(sig)) {
+        res.wdl = 0;
+        res.dtm = 0;
+        return true;
+    }
+    Tablebase* tb = find(sig);
+    return tb&&tb->probe(pos,res);
+}
+
+bool TablebaseSet::best_move(ChessState& pos, minfo& mv) {
+    vector<minfo> moves;
+    pos.all_legal_moves(moves);
+    int32_t best = INT32_MIN;
+    for(minfo cand: moves) {
+        ChessState child = pos;
+        child.execute_move(cand);
+        TBResult res;
+        if(!probe(child,res))
+            continue;
+        // the child is seen from the opponent: prefer its fastest loss, then a draw, then its slowest win
+        int32_t score = (res.wdl<0) ? 1000-res.dtm : (res.wdl==0) ? 0 : -1000+res.dtm;
+        if(score>best) {
+            best = score;
+            mv = cand;
+        }
+    }
+    return best!=INT32_MIN;
+}
+
+// retrograde analysis: positions mated at ply 0 are found by move generation, then every pass
+// un-moves from the positions resolved in the previous pass (a bitmap frontier). Since only white
+// has pieces besides its king, white-to-move positions can only be won or drawn and black-to-move
+// positions only lost or drawn. A white predecessor of a lost black position wins, a black predecessor
+// of a won white position loses once none of its moves is left unresolved (a counter per position).
+// Moves that leave the table (promotions, captures) are looked up in the sub-tables when the position is
+// set up; they either give a draw, or a mate distance that is resolved in the pass of that distance.
+struct TBGen {
+    const Tablebase* tb;
+    vector<uint8_t> types; // pieces besides the kings
+    uint8_t npieces; // including the kings
+    uint32_t half; // positions per side to move
+    atomic<uint8_t>* vals;
+    atomic<uint8_t>* counts; // black to move: legal moves that stay in the table and are not known to lose
+    vector<uint8_t> floors; // black to move: the slowest loss through a capture
+    atomic<uint64_t>* front; // resolved in the previous pass
+    atomic<uint64_t>* next; // resolved in this pass
+    vector<vector<uint32_t> > pending; // positions resolved through sub-tables, by distance
+    mutex pending_lock;
+
+    void decode(uint32_t idx, uint8_t* sqs) const {
+        for(int i=npieces-1; i>=0; i--, idx/=SZ*SZ)
+            sqs[i] = idx%(SZ*SZ);
+    }
+    uint32_t encode(uint32_t side, const uint8_t* sqs) const {
+        uint32_t idx = side;
+        for(uint8_t i=0; i<npieces; i++)
+            idx = idx*SZ*SZ+sqs[i];
+        return idx;
+    }
+    void resolve(uint32_t idx, uint8_t val) {
+        vals[idx] = val;
+        next[idx/64].fetch_or(1ULL<<(idx%64));
+    }
+};
+
+static void tb_setup(TBGen& gen, TablebaseSet& set, uint32_t lo, uint32_t hi) {
+    ChessState st;
+    st.clear();
+    st.cast = 0;
+    st.enpassant = SZ*SZ;
+    st.hmove = 0;
+    st.fmove = 1;
+    vector<minfo> moves;
+    vector<pair<uint8_t,uint32_t> > pending;
+    uint8_t sqs[TB_MAX_PIECES+2];
+    uint8_t pieces[TB_MAX_PIECES+2] = {WK,BK};
+    for(uint8_t i=2; i<gen.npieces; i++)
+        pieces[i] = gen.types[i-2];
+    for(uint32_t idx=lo; idx<hi; idx++) {
+        gen.decode(idx,sqs);
+        bool ok = true;
+        for(uint8_t i=0; i<gen.npieces&&ok; i++) {
+            for(uint8_t j=0; j<i; j++)
+                ok = ok&&sqs[i]!=sqs[j];
+            if(pieces[i]==WP)
+                ok = ok&&sqs[i]/SZ>0&&sqs[i]/SZ<SZ-1;
+        }
+        if(!ok) {
+            gen.vals[idx] = TB_ILLEGAL;
+            continue;
+        }
+        for(uint8_t i=0; i<gen.npieces; i++)
+            st.put(sqs[i],pieces[i]);
+        st.active = (idx<gen.half) ? WT : BT;
+        uint8_t own_king = sqs[(st.active==WT) ? 0 : 1];
+        uint8_t other_king = sqs[(st.active==WT) ? 1 : 0];
+        uint8_t val = TB_UNRESOLVED;
+        if(st.is_checking(st.active,other_king))
+            val = TB_ILLEGAL;
+        else {
+            moves.clear();
+            st.all_legal_moves(moves);
+            uint8_t nmoves = 0;
+            uint8_t best = 0; // white: fastest mate through a promotion, black: slowest loss through a capture
+            bool escape = false; // black: a capture that draws
+            for(minfo mv: moves) {
+                bool capture = st.board[mv.sq2/SZ][mv.sq2%SZ]!=EMP;
+                bool promotion = st.board[mv.sq1/SZ][mv.sq1%SZ]!=mv.newp;
+                if(!capture&&!promotion) {
+                    nmoves++;
+                    continue;
+                }
+                ChessState child = st;
+                child.execute_move(mv);
+                TBResult res;
+                if(!set.probe(child,res))
+                    throw runtime_error("no tablebase for "+Tablebase::signature_of(child));
+                if(st.active==WT&&res.wdl<0)
+                    best = best ? min(best,(uint8_t)(res.dtm+1)) : res.dtm+1;
+                else if(st.active==BT&&res.wdl>0)
+                    best = max(best,(uint8_t)(res.dtm+1));
+                else if(st.active==BT)
+                    escape = true;
+            }
+            if(moves.empty())
+                val = st.is_checking(NEXT(st.active),own_king) ? 0 : TB_DRAW;
+            else if(escape)
+                val = TB_DRAW;
+            else if(st.active==BT) {
+                gen.counts[idx-gen.half] = nmoves;
+                gen.floors[idx-gen.half] = best;
+            }
+            if(val==TB_UNRESOLVED&&best)
+                pending.push_back(make_pair(best,idx));
+        }
+        if(val==0)
+            gen.resolve(idx,val);
+        else
+            gen.vals[idx] = val;
+        for(uint8_t i=0; i<gen.npieces; i++)
+            st.remove(sqs[i]);
+    }
+    lock_guard<mutex> guard(gen.pending_lock);
+    for(auto& pr: pending)
+        gen.pending[pr.first].push_back(pr.second);
+}
+
+static void tb_unmove(TBGen& gen, uint32_t idx, uint8_t n) {
+    uint8_t sqs[TB_MAX_PIECES+2];
+    gen.decode(idx,sqs);
+    uint64_t occupied = 0;
+    for(uint8_t i=0; i<gen.npieces; i++)
+        occupied |= 1ULL<<sqs[i];
+    bool lost = idx>=gen.half; // black to move and mated in n-1: white predecessors win in n
+    uint8_t first = lost ? 0 : 1;
+    uint8_t last = lost ? gen.npieces : 2;
+    for(uint8_t i=first; i<last; i++) {
+        if(i==1&&lost)
+            continue;
+        uint8_t piece = (i<2) ? WK : gen.types[i-2];
+        uint8_t from = sqs[i];
+        int8_t r = from/SZ, c = from%SZ;
+        vector<uint8_t> targets;
+        if(piece==WK||piece==WN) {
+            const int8_t (*steps)[2] = (piece==WK) ? king_steps : knight_steps;
+            for(uint8_t k=0; k<8; k++) {
+                int8_t r2 = r+steps[k][0], c2 = c+steps[k][1];
+                if(r2>=0&&r2<SZ&&c2>=0&&c2<SZ&&!((occupied>>(r2*SZ+c2))&1))
+                    targets.push_back(r2*SZ+c2);
+            }
+        } else if(piece==WP) {
+            // white pawns move to lower rows
+            if(r+1<SZ-1&&!((occupied>>(from+SZ))&1)) {
+                targets.push_back(from+SZ);
+                if(r==SZ/2&&!((occupied>>(from+2*SZ))&1))
+                    targets.push_back(from+2*SZ);
+            }
+        } else {
+            for(uint8_t k=0; k<8; k++) {
+                int8_t dr = king_steps[k][0], dc = king_steps[k][1];
+                bool diagonal = dr&&dc;
+                if((piece==WB&&!diagonal)||(piece==WR&&diagonal))
+                    continue;
+                for(int8_t r2=r+dr, c2=c+dc; r2>=0&&r2<SZ&&c2>=0&&c2<SZ&&!((occupied>>(r2*SZ+c2))&1); r2+=dr, c2+=dc)
+                    targets.push_back(r2*SZ+c2);
+            }
+        }
+        for(uint8_t to: targets) {
+            sqs[i] = to;
+            uint32_t prev = gen.encode(lost ? 0 : 1,sqs);
+            uint8_t expected = TB_UNRESOLVED;
+            if(lost) {
+                if(gen.vals[prev].compare_exchange_strong(expected,n))
+                    gen.next[prev/64].fetch_or(1ULL<<(prev%64));
+            } else if(gen.vals[prev]==TB_UNRESOLVED&&gen.counts[prev-gen.half].fetch_sub(1)==1
+                    &&gen.floors[prev-gen.half]<=n&&gen.vals[prev].compare_exchange_strong(expected,n)) {
+                gen.next[prev/64].fetch_or(1ULL<<(prev%64));
+            }
+        }
+        sqs[i] = from;
+    }
+}
+
+void TablebaseSet::generate(Tablebase& tb) {
+    // sub-tables for promotions and captures first (generation below is not reentrant)
+    string extras = tb.sig.substr(1,tb.sig.size()-2);
+    for(size_t i=0; i<extras.size(); i++) {
+        string rest = extras.substr(0,i)+extras.substr(i+1);
+        vector<string> subs(1,rest);
+        if(extras[i]=='P')
+            for(char type: string("QRBN"))
+                subs.push_back(rest+type);
+        for(string sub: subs) {
+            string order = TB_ORDER;
+            sort(sub.begin(),sub.end(),[&order](char a, char b) { return order.find(a)<order.find(b); });
+            if(Tablebase::mating_material("K"+sub+"K"))
+                get("K"+sub+"K");
+        }
+    }
+
+    TBGen gen;
+    gen.tb = &tb;
+    gen.types = tb.types;
+    gen.npieces = tb.types.size()+2;
+    gen.half = tb.size()/2;
+    uint32_t nwords = tb.size()/64;
+    gen.vals = new atomic<uint8_t>[tb.size()];
+    gen.counts = new atomic<uint8_t>[gen.half];
+    gen.floors.assign(gen.half,0);
+    gen.front = new atomic<uint64_t>[nwords];
+    gen.next = new atomic<uint64_t>[nwords];
+    for(uint32_t w=0; w<nwords; w++)
+        gen.next[w] = 0;
+    gen.pending.resize(TB_MAX_DTM+2);
+
+    ThreadPool pool(max(nthreads,1U));
+    atomic<bool> failed(false);
+    string error;
+    for(uint32_t lo=0; lo<tb.size(); lo+=TB_CHUNK) {
+        pool.submit([&gen,this,&failed,&error,lo]() {
+            try {
+                tb_setup(gen,*this,lo,min(lo+TB_CHUNK,gen.tb->size()));
+            } catch(const runtime_error& e) {
+                lock_guard<mutex> guard(gen.pending_lock);
+                failed = true;
+                error = e.what();
+            }
+        });
+    }
+    pool.wait();
+
+    uint32_t last = 0; // last distance with pending positions
+    for(uint32_t d=0; d<gen.pending.size(); d++)
+        if(!gen.pending[d].empty())
+            last = d;
+    for(uint32_t n=1; !failed; n++) {
+        swap(gen.front,gen.next);
+        bool any = false;
+        for(uint32_t w=0; w<nwords; w++) {
+            any = any||gen.front[w];
+            gen.next[w] = 0;
+        }
+        if(!any&&n>last)
+            break;
+        if(n>TB_MAX_DTM) {
+            failed = true;
+            error = "distance to mate overflow in "+tb.sig;
+            break;
+        }
+        for(uint32_t lo=0; lo<nwords; lo+=TB_CHUNK/64) {
+            pool.submit([&gen,lo,nwords,n]() {
+                for(uint32_t w=lo; w<min(lo+TB_CHUNK/64,nwords); w++)
+                    for(uint64_t bits=gen.front[w]; bits; bits&=bits-1)
+                        tb_unmove(gen,w*64+__builtin_ctzll(bits),n);
+            });
+        }
+        pool.wait();
+        for(uint32_t idx: gen.pending[n]) {
+            if(gen.vals[idx]==TB_UNRESOLVED&&(idx<gen.half||gen.counts[idx-gen.half]==0))
+                gen.resolve(idx,n);
+        }
+    }
+
+    if(!failed) {
+        tb.data.resize(tb.size());
+        for(uint32_t idx=0; idx<tb.size(); idx++)
+            tb.data[idx] = (gen.vals[idx]==TB_UNRESOLVED) ? TB_DRAW : (uint8_t)gen.vals[idx];
+    }
+    delete[] gen.vals;
+    delete[] gen.counts;
+    delete[] gen.front;
+    delete[] gen.next;
+    if(failed)
+        throw runtime_error(error);
+}
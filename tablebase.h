@@ -0,0 +1,59 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+#include "chess_state.h"
+#include <thread>
+
+// endgame tablebases for a lone king against a king with up to two pieces (KQK, KRK, KPK, KBNK, ...)
+// tables are stored with the stronger side as white, one byte per position:
+// index = side to move, white king, black king, white pieces (in QRBNP order), 6 bits per square
+// the byte is the distance to mate in plies (even: side to move is mated, odd: side to move mates), TB_DRAW or TB_ILLEGAL
+// positions with castling rights are not covered
+
+#define TB_MAX_PIECES 2 // besides the kings
+#define TB_DRAW 0xFE
+#define TB_ILLEGAL 0xFF
+#define TB_MAX_DTM 0xFC
+
+struct TBResult {
+    int8_t wdl; // 1 side to move wins, 0 draw, -1 side to move loses
+    uint8_t dtm; // plies to mate, 0 for draws
+};
+
+class Tablebase {
+    public:
+        Tablebase(const string& sig); // canonical signature like "KBNK", throws invalid_argument for unsupported material
+        const string& signature() const;
+        uint32_t size() const; // number of positions (including illegal ones)
+        uint8_t value(uint32_t idx) const;
+        bool probe(const ChessState& pos, TBResult& res) const; // false if pos has other material or castling rights
+        void load(const string& path); // throws runtime_error
+        void save(const string& path) const;
+
+        static string signature_of(const ChessState& pos); // canonical signature, "" if both sides have pieces
+        static bool mating_material(const string& sig); // false for signatures that are always drawn (KK, KNK, KBK)
+
+    private:
+        friend class TablebaseSet;
+        string sig;
+        vector<uint8_t> types; // white pieces besides the king, in canonical order
+        vector<uint8_t> data;
+        uint32_t index(bool active, const uint8_t* sqs) const; // sqs: white king, black king, then pieces as in types
+        bool squares(const ChessState& pos, bool& active, uint8_t* sqs) const; // normalized to white as the stronger side
+};
+
+class TablebaseSet { // tables by signature, can generate missing tables and their sub-tables
+    public:
+        TablebaseSet(const string& dir, uint32_t threads=thread::hardware_concurrency());
+        ~TablebaseSet();
+        const Tablebase& get(const string& sig); // loads dir/sig.ctb or generates and saves it
+        bool probe(const ChessState& pos, TBResult& res); // draws without mating material, false if no table covers pos
+        bool best_move(ChessState& pos, minfo& mv); // fastest mate, slowest loss, or any drawing move
+    private:
+        string dir;
+        uint32_t nthreads;
+        map<string,Tablebase*> tables;
+        Tablebase* find(const string& sig); // loaded or on disk, NULL otherwise
+        void generate(Tablebase& tb);
+};
+
+#endif
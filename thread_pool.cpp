@@ -0,0 +1,62 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(uint32_t nworkers) : next(0), pending(0), stopping(false) {
+    if(nworkers==0)
+        nworkers = 1;
+    for(uint32_t i=0; i<nworkers; i++)
+        workers.push_back(new Worker());
+    for(Worker* wk: workers)
+        wk->th = thread(&ThreadPool::run,this,wk);
+}
+
+ThreadPool::~ThreadPool() {
+    for(Worker* wk: workers) {
+        lock_guard<mutex> lock(wk->lock);
+        stopping = true;
+        wk->ready.notify_one();
+    }
+    for(Worker* wk: workers) {
+        wk->th.join();
+        delete wk;
+    }
+}
+
+uint32_t ThreadPool::size() const {
+    return workers.size();
+}
+
+void ThreadPool::submit(uint32_t worker, function<void()> job) {
+    Worker* wk = workers[worker%workers.size()];
+    pending++;
+    lock_guard<mutex> lock(wk->lock);
+    wk->jobs.push_back(move(job));
+    wk->ready.notify_one();
+}
+
+void ThreadPool::submit(function<void()> job) {
+    submit(next++,move(job));
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> lock(idle_lock);
+    idle.wait(lock,[this]{ return pending==0; });
+}
+
+void ThreadPool::run(Worker* wk) {
+    while(true) {
+        function<void()> job;
+        {
+            unique_lock<mutex> lock(wk->lock);
+            wk->ready.wait(lock,[this,wk]{ return stopping||!wk->jobs.empty(); });
+            if(wk->jobs.empty())
+                return; // stopping and nothing left to do
+            job = move(wk->jobs.front());
+            wk->jobs.pop_front();
+        }
+        job();
+        if(--pending==0) {
+            lock_guard<mutex> lock(idle_lock);
+            idle.notify_all();
+        }
+    }
+}
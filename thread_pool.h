@@ -0,0 +1,38 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+using namespace std;
+
+class ThreadPool { // fixed number of workers, each with its own queue so that jobs can be pinned to a worker
+    public:
+        ThreadPool(uint32_t nworkers=thread::hardware_concurrency());
+        ~ThreadPool(); // finishes the queued jobs, then joins
+        void submit(uint32_t worker, function<void()> job); // runs on worker%size(), in submission order
+        void submit(function<void()> job); // round robin
+        void wait(); // until every submitted job has finished
+        uint32_t size() const;
+
+    private:
+        struct Worker {
+            mutex lock;
+            condition_variable ready;
+            deque<function<void()> > jobs;
+            thread th;
+        };
+        vector<Worker*> workers;
+        atomic<uint32_t> next;
+        atomic<uint64_t> pending;
+        atomic<bool> stopping;
+        mutex idle_lock;
+        condition_variable idle;
+        void run(Worker* wk);
+};
+
+#endif